@@ -21,8 +21,20 @@
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "obuparse.h"
 
+/* Fails to compile if OBPState grows past its documented budget. */
+typedef char _obp_state_size_check[(sizeof(OBPState) <= OBP_STATE_SIZE_BUDGET) ? 1 : -1];
+
 /************************************
  * Bitreader functions and structs. *
  ************************************/
@@ -41,6 +53,50 @@ static inline _OBPBitReader _obp_new_br(uint8_t *buf, size_t buf_size)
     return ret;
 }
 
+#if OBP_WORD_BITREADER
+static inline uint64_t _obp_rb64(uint8_t *buf)
+{
+    return (((uint64_t) buf[0]) << 56) | (((uint64_t) buf[1]) << 48) |
+           (((uint64_t) buf[2]) << 40) | (((uint64_t) buf[3]) << 32) |
+           (((uint64_t) buf[4]) << 24) | (((uint64_t) buf[5]) << 16) |
+           (((uint64_t) buf[6]) << 8)  |  ((uint64_t) buf[7]);
+}
+
+static inline uint64_t _obp_br_unchecked(_OBPBitReader *br, uint8_t n)
+{
+    assert(n <= 63);
+
+    if (n > br->bits_in_buf) {
+        if (br->bits_in_buf <= 56 && br->buf_size - br->buf_pos >= 8) {
+            /*
+             * Refill as many whole bytes as fit in the bit buffer with a single
+             * big-endian 64-bit load. The shift is split in two, since it can be
+             * a full 64 bits when the buffer is empty.
+             */
+            uint8_t bits = (64 - br->bits_in_buf) & ~7;
+            br->bit_buffer   = ((br->bit_buffer << (bits - 1)) << 1) | (_obp_rb64(br->buf + br->buf_pos) >> (64 - bits));
+            br->bits_in_buf += bits;
+            br->buf_pos     += bits >> 3;
+        } else {
+            /* Less than a word left in the buffer; refill byte by byte. */
+            while (n > br->bits_in_buf && br->bits_in_buf <= 56) {
+                br->bit_buffer <<= 8;
+                br->bit_buffer  |= (uint64_t) br->buf[br->buf_pos];
+                br->bits_in_buf += 8;
+                br->buf_pos++;
+            }
+        }
+
+        if (n > br->bits_in_buf) {
+            uint64_t hi = _obp_br_unchecked(br, n - 32);
+            return (hi << 32) | _obp_br_unchecked(br, 32);
+        }
+    }
+
+    br->bits_in_buf -= n;
+    return (br->bit_buffer >> br->bits_in_buf) & ((((uint64_t)1) << n) - 1);
+}
+#else
 static inline uint64_t _obp_br_unchecked(_OBPBitReader *br, uint8_t n)
 {
     assert(n <= 63);
@@ -63,6 +119,7 @@ static inline uint64_t _obp_br_unchecked(_OBPBitReader *br, uint8_t n)
     br->bits_in_buf -= n;
     return (br->bit_buffer >> br->bits_in_buf) & ((((uint64_t)1) << n) - 1);
 }
+#endif
 
 static inline void _obp_br_byte_alignment(_OBPBitReader *br)
 {
@@ -74,21 +131,81 @@ static inline size_t _obp_br_get_pos(_OBPBitReader *br)
     return (br->buf_pos * 8) - ((size_t) br->bits_in_buf);
 }
 
+/*
+ * Records why and where parsing failed. The message is only formatted if the user
+ * provided a buffer for it.
+ */
+#define _obp_error(err, c, elem, pos, ...) do { \
+    (err)->code    = (c); \
+    (err)->element = (elem); \
+    (err)->bit_pos = (pos); \
+    if ((err)->size > 0) \
+        snprintf((err)->error, (err)->size, __VA_ARGS__); \
+} while(0)
+
+/*
+ * Prepends context to a message already written by a nested call, in place.
+ */
+static void _obp_error_prefix(OBPError *err, const char *prefix)
+{
+    size_t prefix_len, msg_len;
+
+    if (err->size == 0)
+        return;
+
+    prefix_len = strlen(prefix);
+    if (prefix_len >= err->size) {
+        snprintf(err->error, err->size, "%s", prefix);
+        return;
+    }
+
+    msg_len = strlen(err->error);
+    if (msg_len > err->size - 1 - prefix_len)
+        msg_len = err->size - 1 - prefix_len;
+
+    memmove(err->error + prefix_len, err->error, msg_len);
+    memcpy(err->error, prefix, prefix_len);
+    err->error[prefix_len + msg_len] = '\0';
+}
+
 #if OBP_UNCHECKED_BITREADER
+/* err is still named, so that functions which only pass it here don't warn about it. */
 #define _obp_br(x, br, n) do { \
+    (void) err; \
     x = _obp_br_unchecked(br, n); \
 } while(0)
 #else
 #define _obp_br(x, br, n) do { \
-    size_t bytes_needed = ((n - br->bits_in_buf) + (1<<3) - 1) >> 3; \
-    if (bytes_needed > (br->buf_size - br->buf_pos)) { \
-        snprintf(err->error, err->size, "Ran out of bytes in buffer."); \
-        return -1; \
+    if ((n) > br->bits_in_buf) { \
+        size_t bytes_needed = (((n) - br->bits_in_buf) + (1<<3) - 1) >> 3; \
+        if (bytes_needed > (br->buf_size - br->buf_pos)) { \
+            _obp_error(err, OBP_ERROR_OUT_OF_DATA, #x, _obp_br_get_pos(br), "Ran out of bytes in buffer."); \
+            return -1; \
+        } \
     } \
     x = _obp_br_unchecked(br, n); \
 } while(0)
 #endif
 
+static inline size_t _obp_br_bits_left(_OBPBitReader *br)
+{
+    return ((br->buf_size - br->buf_pos) * 8) + ((size_t) br->bits_in_buf);
+}
+
+/*
+ * For fixed-layout syntax blocks, the caller can check once that the block's worst-case
+ * size fits in the remaining bits, and then read the whole block unchecked. 'checked'
+ * must be a constant at each call site of the block, so that the compiler generates a
+ * separate copy of the block for each case.
+ */
+#define _obp_br_maybe(x, br, n, checked) do { \
+    if (checked) { \
+        _obp_br(x, br, n); \
+    } else { \
+        x = _obp_br_unchecked(br, n); \
+    } \
+} while(0)
+
 /************************************
  * Functions from AV1 specification. *
  ************************************/
@@ -102,7 +219,7 @@ static inline int _obp_leb128(uint8_t *buf, size_t size, uint64_t *value, ptrdif
         uint8_t b;
 
         if (((size_t) (*consumed) + 1) > size) {
-            snprintf(err->error, err->size, "Buffer too short to read leb128 value.");
+            _obp_error(err, OBP_ERROR_OUT_OF_DATA, "leb128()", size * 8, "Buffer too short to read leb128 value.");
             return -1;
         }
 
@@ -128,7 +245,7 @@ static inline int _obp_uvlc(_OBPBitReader *br, uint32_t *value, OBPError *err)
         leading_zeroes++;
     }
     if (leading_zeroes == 32) {
-        snprintf(err->error, err->size, "Invalid VLC.");
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "uvlc()", _obp_br_get_pos(br), "Invalid VLC.");
         return -1;
     }
     uint32_t val;
@@ -139,16 +256,10 @@ static inline int _obp_uvlc(_OBPBitReader *br, uint32_t *value, OBPError *err)
 
 static inline int32_t _obp_get_relative_dist(int32_t a, int32_t b, OBPSequenceHeader *seq)
 {
-    int32_t diff, m;
-
-    if (!seq->enable_order_hint)
-        return 0;
+    /* Both masks are zero if enable_order_hint is 0, making this return 0 without a branch. */
+    int32_t diff = a - b;
 
-    diff = a - b;
-    m    = 1 << (seq->OrderHintBits - 1);
-    diff = (diff & (m - 1)) - (diff & m);
-
-    return diff;
+    return (diff & (int32_t) seq->OrderHintLowMask) - (diff & (int32_t) seq->OrderHintSignBit);
 }
 
 
@@ -184,6 +295,14 @@ static inline uint64_t _obp_le(uint8_t *buf, uint8_t n)
     return t;
 }
 
+static inline uint64_t _obp_be(uint8_t *buf, uint8_t n)
+{
+    uint64_t t = 0;
+    for (uint8_t i = 0; i < n; i++)
+        t = (t << 8) | buf[i];
+    return t;
+}
+
 static inline int _obp_ns(_OBPBitReader *br, uint32_t n, uint32_t *out, OBPError *err)
 {
     uint32_t w = _obp_floor_log2(n) + 1;
@@ -202,17 +321,21 @@ static inline int _obp_ns(_OBPBitReader *br, uint32_t n, uint32_t *out, OBPError
     return 0;
 }
 
+static inline int32_t _obp_su_value(int32_t value, uint32_t n)
+{
+    uint32_t signMask = ((uint32_t)1) << (n - 1);
+    if (value & signMask) {
+        value = value - 2 * signMask;
+    }
+    return value;
+}
+
 static inline int _obp_su(_OBPBitReader *br, uint32_t n, int32_t *out, OBPError *err)
 {
     int32_t value;
-    uint32_t signMask;
 
     _obp_br(value, br, n);
-    signMask = ((uint32_t)1) << (n - 1);
-    if (value & signMask) {
-        value = value - 2 * signMask;
-    }
-    *out = value;
+    *out = _obp_su_value(value, n);
     return 0;
 }
 
@@ -300,6 +423,9 @@ static inline int _obp_decode_signed_subexp_with_ref(_OBPBitReader *br, int32_t
 #define _OBP_MAX(x,y) ((x) > (y) ? x : y)
 #define _OBP_MIN(x,y) ((x) < (y) ? x : y)
 
+/* Field groups are in bitstream order, so parsing can stop once no later group is wanted. */
+#define _obp_skip_from(fields, group) ((fields) < (uint32_t) (group))
+
 static inline int _obp_is_valid_obu(OBPOBUType type)
 {
     return type == OBP_OBU_SEQUENCE_HEADER ||
@@ -313,6 +439,60 @@ static inline int _obp_is_valid_obu(OBPOBUType type)
            type == OBP_OBU_PADDING;
 }
 
+/*
+ * Film grain is only stored for reference slots where it was applied; reset_grain_params()
+ * leaves everything zeroed otherwise.
+ */
+static inline void _obp_load_grain_params(OBPFilmGrainParameters *params, OBPState *state, int idx)
+{
+    if ((state->RefApplyGrain >> idx) & 1)
+        *params = state->RefGrainParams[idx];
+    else
+        memset(params, 0, sizeof(*params));
+}
+
+/*
+ * Global motion is only stored for LAST_FRAME through ALTREF_FRAME. INTRA_FRAME always
+ * has the default (identity) parameters.
+ */
+static inline int32_t _obp_saved_gm_param(OBPState *state, int idx, int ref, int i)
+{
+    if (ref == 0)
+        return (i % 3 == 2) ? (((int32_t)1) << 16) : 0;
+    return state->SavedGmParams[idx][ref - 1][i];
+}
+
+/*
+ * The field groups a parse reads through: every group up to and including the last one
+ * requested.
+ */
+static inline uint32_t _obp_parsed_fields(uint32_t fields)
+{
+    uint32_t parsed = 0;
+
+    for (uint32_t group = OBP_FIELD_TILE_INFO; group <= fields && group <= OBP_FIELD_FILM_GRAIN; group <<= 1)
+        parsed |= group;
+
+    return parsed;
+}
+
+/*
+ * Reference slots saved by a field-limited parse hold no valid state for the groups it
+ * skipped, so refuse to load them into a parse which reads those groups.
+ */
+static inline int _obp_check_ref_fields(OBPState *state, int idx, uint32_t fields, uint32_t groups, OBPError *err)
+{
+    uint32_t missing = _obp_parsed_fields(fields) & groups & state->RefSkippedFields[idx];
+
+    if (missing) {
+        _obp_error(err, OBP_ERROR_INVALID_STATE, NULL, 0,
+                   "Reference frame %d was saved without field groups 0x%"PRIx32", which are needed here.", idx, missing);
+        return -1;
+    }
+
+    return 0;
+}
+
 static inline int _obp_set_frame_refs(OBPFrameHeader *fh, OBPSequenceHeader *seq, OBPState *state, OBPError *err)
 {
     int usedFrame[8];
@@ -332,14 +512,15 @@ static inline int _obp_set_frame_refs(OBPFrameHeader *fh, OBPSequenceHeader *seq
     }
     usedFrame[fh->last_frame_idx] = 1;
     usedFrame[fh->gold_frame_idx] = 2;
-    curFrameHint                  = 1 << (seq->OrderHintBits - 1);
+    curFrameHint                  = (int32_t) seq->OrderHintSignBit;
     for (int i = 0; i < 8; i++) {
         shiftedOrderHints[i] = curFrameHint + _obp_get_relative_dist(state->RefOrderHint[i], fh->order_hint, seq);
     }
     lastOrderHint = shiftedOrderHints[fh->last_frame_idx];
     goldOrderHint = shiftedOrderHints[fh->gold_frame_idx];
     if (lastOrderHint >= curFrameHint || goldOrderHint >= curFrameHint) {
-        snprintf(err->error, err->size, "(lastOrderHint >= curFrameHint || goldOrderHint >= curFrameHint) not allowed.");
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "gold_frame_idx", 0,
+                   "(lastOrderHint >= curFrameHint || goldOrderHint >= curFrameHint) not allowed.");
         return -1;
     }
     /* find_latest_backward() */
@@ -423,6 +604,182 @@ static inline int _obp_set_frame_refs(OBPFrameHeader *fh, OBPSequenceHeader *seq
     return 0;
 }
 
+/*
+ * One iteration of the operating point loop in sequence_header_obu(). The worst case
+ * has two 32-bit buffer delays.
+ */
+#define _OBP_OPERATING_POINT_MAX_BITS (12 + 5 + 1 + 1 + 2 * 32 + 1 + 1 + 4)
+
+static inline int _obp_read_operating_point(_OBPBitReader *br, OBPSequenceHeader *seq_header, uint8_t i, int checked, OBPError *err)
+{
+    _obp_br_maybe(seq_header->operating_point_idc[i], br, 12, checked);
+    _obp_br_maybe(seq_header->seq_level_idx[i], br, 5, checked);
+    if (seq_header->seq_level_idx[i] > 7) {
+        _obp_br_maybe(seq_header->seq_tier[i], br, 1, checked);
+    } else {
+        seq_header->seq_tier[i] = 0;
+    }
+    if (seq_header->decoder_model_info_present_flag) {
+        _obp_br_maybe(seq_header->decoder_model_present_for_this_op[i], br, 1, checked);
+        if (seq_header->decoder_model_present_for_this_op[i]) {
+            /* operating_parameters_info() */
+            uint8_t n = seq_header->decoder_model_info.buffer_delay_length_minus_1 + 1;
+            _obp_br_maybe(seq_header->operating_parameters_info[i].decoder_buffer_delay, br, n, checked);
+            _obp_br_maybe(seq_header->operating_parameters_info[i].encoder_buffer_delay, br, n, checked);
+            _obp_br_maybe(seq_header->operating_parameters_info[i].low_delay_mode_flag, br, 1, checked);
+        }
+    } else {
+        seq_header->decoder_model_present_for_this_op[i] = 0;
+    }
+    if (seq_header->initial_display_delay_present_flag) {
+        _obp_br_maybe(seq_header->initial_display_delay_present_for_this_op[i], br, 1, checked);
+        if (seq_header->initial_display_delay_present_for_this_op[i]) {
+            _obp_br_maybe(seq_header->initial_display_delay_minus_1[i], br, 4, checked);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * The run of coding tool flags in sequence_header_obu(), from use_128x128_superblock to
+ * enable_restoration.
+ */
+#define _OBP_SEQUENCE_TOOLS_MAX_BITS (3 + 5 + 2 + 4 + 3 + 3)
+
+static inline int _obp_read_sequence_tools(_OBPBitReader *br, OBPSequenceHeader *seq_header, int checked, OBPError *err)
+{
+    _obp_br_maybe(seq_header->use_128x128_superblock, br, 1, checked);
+    _obp_br_maybe(seq_header->enable_filter_intra, br, 1, checked);
+    _obp_br_maybe(seq_header->enable_intra_edge_filter, br, 1, checked);
+    if (seq_header->reduced_still_picture_header) {
+        seq_header->enable_interintra_compound     = 0;
+        seq_header->enable_masked_compound         = 0;
+        seq_header->enable_warped_motion           = 0;
+        seq_header->enable_dual_filter             = 0;
+        seq_header->enable_order_hint              = 0;
+        seq_header->enable_jnt_comp                = 0;
+        seq_header->enable_ref_frame_mvs           = 0;
+        seq_header->seq_force_screen_content_tools = 2; /* SELECT_SCREEN_CONTENT_TOOLS */
+        seq_header->seq_force_integer_mv           = 2; /* SELECT_INTEGER_MV */
+        seq_header->OrderHintBits                  = 0;
+    } else {
+        _obp_br_maybe(seq_header->enable_interintra_compound, br, 1, checked);
+        _obp_br_maybe(seq_header->enable_masked_compound, br, 1, checked);
+        _obp_br_maybe(seq_header->enable_warped_motion, br, 1, checked);
+        _obp_br_maybe(seq_header->enable_dual_filter, br, 1, checked);
+        _obp_br_maybe(seq_header->enable_order_hint, br, 1, checked);
+        if (seq_header->enable_order_hint) {
+            _obp_br_maybe(seq_header->enable_jnt_comp, br, 1, checked);
+            _obp_br_maybe(seq_header->enable_ref_frame_mvs, br, 1, checked);
+        } else {
+            seq_header->enable_jnt_comp = 0;
+            seq_header->enable_ref_frame_mvs = 0;
+        }
+        _obp_br_maybe(seq_header->seq_choose_screen_content_tools, br, 1, checked);
+        if (seq_header->seq_choose_screen_content_tools) {
+            seq_header->seq_force_screen_content_tools = 2; /* SELECT_SCREEN_CONTENT_TOOLS */
+        } else {
+            _obp_br_maybe(seq_header->seq_force_screen_content_tools, br, 1, checked);
+        }
+        if (seq_header->seq_force_screen_content_tools > 0) {
+            _obp_br_maybe(seq_header->seq_choose_integer_mv, br, 1, checked);
+            if (seq_header->seq_choose_integer_mv) {
+                seq_header->seq_force_integer_mv = 2; /* SELECT_INTEGER_MV */
+            } else {
+                _obp_br_maybe(seq_header->seq_force_integer_mv, br, 1, checked);
+            }
+        } else {
+            seq_header->seq_force_integer_mv = 2; /* SELECT_INTEGER_MV */
+        }
+        if (seq_header->enable_order_hint) {
+            _obp_br_maybe(seq_header->order_hint_bits_minus_1, br, 3, checked);
+            seq_header->OrderHintBits = seq_header->order_hint_bits_minus_1 + 1;
+        } else {
+            seq_header->OrderHintBits = 0;
+        }
+    }
+    _obp_br_maybe(seq_header->enable_superres, br, 1, checked);
+    _obp_br_maybe(seq_header->enable_cdef, br, 1, checked);
+    _obp_br_maybe(seq_header->enable_restoration, br, 1, checked);
+
+    return 0;
+}
+
+/*
+ * loop_filter_params(), minus the lossless/intrabc case. At most four 6-bit levels,
+ * sharpness, two flags, and eight plus two delta updates of 1 + 7 bits each.
+ */
+#define _OBP_LOOP_FILTER_PARAMS_MAX_BITS (4 * 6 + 3 + 1 + 1 + (8 + 2) * (1 + 7))
+
+static inline int _obp_read_loop_filter_params(_OBPBitReader *br, OBPSequenceHeader *seq, OBPFrameHeader *fh, int checked, OBPError *err)
+{
+    _obp_br_maybe(fh->loop_filter_params.loop_filter_level[0], br, 6, checked);
+    _obp_br_maybe(fh->loop_filter_params.loop_filter_level[1], br, 6, checked);
+    if (seq->color_config.NumPlanes > 1) {
+        if (fh->loop_filter_params.loop_filter_level[0] || fh->loop_filter_params.loop_filter_level[1]) {
+            _obp_br_maybe(fh->loop_filter_params.loop_filter_level[2], br, 6, checked);
+            _obp_br_maybe(fh->loop_filter_params.loop_filter_level[3], br, 6, checked);
+        }
+    }
+    _obp_br_maybe(fh->loop_filter_params.loop_filter_sharpness, br, 3, checked);
+    _obp_br_maybe(fh->loop_filter_params.loop_filter_delta_enabled, br, 1, checked);
+    if (fh->loop_filter_params.loop_filter_delta_enabled == 1) {
+        _obp_br_maybe(fh->loop_filter_params.loop_filter_delta_update, br, 1, checked);
+        if (fh->loop_filter_params.loop_filter_delta_update == 1) {
+            for (int i = 0; i < 8; i++) {
+                int update_ref_delta;
+                _obp_br_maybe(update_ref_delta, br, 1, checked);
+                if (update_ref_delta) {
+                    int32_t val;
+                    _obp_br_maybe(val, br, 7, checked);
+                    fh->loop_filter_params.loop_filter_ref_deltas[i] = _obp_su_value(val, 7);
+                }
+            }
+            for (int i = 0; i < 2; i++) {
+                int update_mode_delta;
+                _obp_br_maybe(update_mode_delta, br, 1, checked);
+                if (update_mode_delta) {
+                    int32_t val;
+                    _obp_br_maybe(val, br, 7, checked);
+                    fh->loop_filter_params.loop_filter_mode_deltas[i] = _obp_su_value(val, 7);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * cdef_params(), minus the disabled case. Damping, cdef_bits, and up to eight sets of
+ * luma and chroma strengths.
+ */
+#define _OBP_CDEF_PARAMS_MAX_BITS (2 + 2 + 8 * (4 + 2 + 4 + 2))
+
+static inline int _obp_read_cdef_params(_OBPBitReader *br, OBPSequenceHeader *seq, OBPFrameHeader *fh, int checked, OBPError *err)
+{
+    _obp_br_maybe(fh->cdef_params.cdef_damping_minus_3, br, 2, checked);
+    /* CdefDamping not relevant to OBU parsing. */
+    _obp_br_maybe(fh->cdef_params.cdef_bits, br, 2, checked);
+    for (int i = 0; i < (1 << fh->cdef_params.cdef_bits); i++) {
+        _obp_br_maybe(fh->cdef_params.cdef_y_pri_strength[i], br, 4, checked);
+        _obp_br_maybe(fh->cdef_params.cdef_y_sec_strength[i], br, 2, checked);
+        if (fh->cdef_params.cdef_y_sec_strength[i] == 3) {
+            fh->cdef_params.cdef_y_sec_strength[i] += 1;
+        }
+        if (seq->color_config.NumPlanes > 1) {
+            _obp_br_maybe(fh->cdef_params.cdef_uv_pri_strength[i], br, 4, checked);
+            _obp_br_maybe(fh->cdef_params.cdef_uv_sec_strength[i], br, 2, checked);
+            if (fh->cdef_params.cdef_uv_sec_strength[i] == 3) {
+                fh->cdef_params.cdef_uv_sec_strength[i] += 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
 static inline int _obp_read_delta_q(_OBPBitReader *br, int32_t *out, OBPError *err)
 {
     int delta_coded;
@@ -490,20 +847,15 @@ static inline int _obp_read_global_param(_OBPBitReader *br, OBPFrameHeader *fh,
     return 0;
 }
 
-
-/*****************************
- * API functions start here. *
- *****************************/
-
-int obp_get_next_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdiff_t *offset,
-                     size_t *size, int *temporal_id, int *spatial_id, OBPError *err)
+static inline int _obp_get_next_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdiff_t *offset,
+                                    size_t *size, int *temporal_id, int *spatial_id, OBPError *err)
 {
     ptrdiff_t pos = 0;
     int obu_extension_flag;
     int obu_has_size_field;
 
     if (buf_size < 1) {
-        snprintf(err->error, err->size, "Buffer is too small to contain an OBU.");
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, "obu_header()", 0, "Buffer is too small to contain an OBU.");
         return -1;
     }
 
@@ -513,13 +865,14 @@ int obp_get_next_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdif
     pos++;
 
     if (!_obp_is_valid_obu(*obu_type)) {
-        snprintf(err->error, err->size, "OBU header contains invalid OBU type: %d", *obu_type);
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "obu_type", 1, "OBU header contains invalid OBU type: %d", *obu_type);
         return -1;
     }
 
     if (obu_extension_flag) {
         if (buf_size < 2) {
-            snprintf(err->error, err->size, "Buffer is too small to contain an OBU extension header.");
+            _obp_error(err, OBP_ERROR_OUT_OF_DATA, "obu_extension_header()", 8,
+                       "Buffer is too small to contain an OBU extension header.");
             return -1;
         }
         *temporal_id = (buf[pos] & 0xE0) >> 5;
@@ -531,18 +884,22 @@ int obp_get_next_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdif
     }
 
     if (obu_has_size_field) {
-        char err_buf[1024];
         uint64_t value;
         ptrdiff_t consumed;
-        OBPError error = { &err_buf[0], 1024 };
 
-        int ret      = _obp_leb128(buf + pos, buf_size - (size_t) pos, &value, &consumed, &error);
+        int ret      = _obp_leb128(buf + pos, buf_size - (size_t) pos, &value, &consumed, err);
         if (ret < 0) {
-            snprintf(err->error, err->size, "Failed to read OBU size: %s", &error.error[0]);
+            err->element  = "obu_size";
+            err->bit_pos += (size_t) pos * 8;
+            _obp_error_prefix(err, "Failed to read OBU size: ");
             return -1;
         }
 
-        assert(value < UINT32_MAX);
+        if (value >= UINT32_MAX) {
+            _obp_error(err, OBP_ERROR_INVALID_DATA, "obu_size", (size_t) pos * 8,
+                       "Invalid OBU size: %"PRIu64" is not less than 2^32 - 1.", value);
+            return -1;
+        }
 
         *offset = (ptrdiff_t) pos + consumed;
         *size   = (size_t) value;
@@ -552,267 +909,190 @@ int obp_get_next_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdif
     }
 
     if (*size > buf_size - (size_t) *offset) {
-        snprintf(err->error, err->size, "Invalid OBU size: larger than remaining buffer.");
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "obu_size", (size_t) *offset * 8,
+                   "Invalid OBU size: larger than remaining buffer.");
         return -1;
     }
 
     return 0;
 }
 
-int obp_parse_sequence_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq_header, OBPError *err)
+static inline int _obp_get_annexb_unit(uint8_t *buf, size_t buf_size, const char *element, ptrdiff_t *offset,
+                                       size_t *unit_size, OBPError *err)
 {
-    _OBPBitReader b   = _obp_new_br(buf, buf_size);
-    _OBPBitReader *br = &b;
+    uint64_t value;
+    ptrdiff_t consumed;
 
-    _obp_br(seq_header->seq_profile, br, 3);
-    _obp_br(seq_header->still_picture, br, 1);
-    _obp_br(seq_header->reduced_still_picture_header, br, 1);
-    if (seq_header->reduced_still_picture_header) {
-        seq_header->timing_info_present_flag                     = 0;
-        seq_header->decoder_model_info_present_flag              = 0;
-        seq_header->initial_display_delay_present_flag           = 0;
-        seq_header->operating_points_cnt_minus_1                 = 0;
-        seq_header->operating_point_idc[0]                       = 0;
-        _obp_br(seq_header->seq_level_idx[0], br, 5);
-        seq_header->seq_tier[0]                                  = 0;
-        seq_header->decoder_model_present_for_this_op[0]         = 0;
-        seq_header->initial_display_delay_present_for_this_op[0] = 0;
-    } else {
-        _obp_br(seq_header->timing_info_present_flag, br, 1);
-        if (seq_header->timing_info_present_flag) {
-            /* timing_info() */
-            _obp_br(seq_header->timing_info.num_units_in_display_tick, br, 32);
-            _obp_br(seq_header->timing_info.time_scale, br, 32);
-            _obp_br(seq_header->timing_info.equal_picture_interval, br, 1);
-            if (seq_header->timing_info.equal_picture_interval) {
-                int ret = _obp_uvlc(br, &seq_header->timing_info.num_ticks_per_picture_minus_1, err);
-                if (ret < 0)
-                    return -1;
-            }
-            _obp_br(seq_header->decoder_model_info_present_flag, br, 1);
-            if (seq_header->decoder_model_info_present_flag) {
-                /* decoder_model_info() */
-                _obp_br(seq_header->decoder_model_info.buffer_delay_length_minus_1, br, 5);
-                _obp_br(seq_header->decoder_model_info.num_units_in_decoding_tick, br, 32);
-                _obp_br(seq_header->decoder_model_info.buffer_removal_time_length_minus_1, br, 5);
-                _obp_br(seq_header->decoder_model_info.frame_presentation_time_length_minus_1, br, 5);
-            }
-        } else {
-            seq_header->decoder_model_info_present_flag = 0;
-        }
-        _obp_br(seq_header->initial_display_delay_present_flag, br, 1);
-        _obp_br(seq_header->operating_points_cnt_minus_1, br, 5);
-        for (uint8_t i = 0; i <= seq_header->operating_points_cnt_minus_1; i++) {
-            _obp_br(seq_header->operating_point_idc[i], br, 12);
-            _obp_br(seq_header->seq_level_idx[i], br, 5);
-            if (seq_header->seq_level_idx[i] > 7) {
-                _obp_br(seq_header->seq_tier[i], br, 1);
-            } else {
-                seq_header->seq_tier[i] = 0;
-            }
-            if (seq_header->decoder_model_info_present_flag) {
-                _obp_br(seq_header->decoder_model_present_for_this_op[i], br, 1);
-                if (seq_header->decoder_model_present_for_this_op[i]) {
-                    /* operating_parameters_info() */
-                    uint8_t n = seq_header->decoder_model_info.buffer_delay_length_minus_1 + 1;
-                    _obp_br(seq_header->operating_parameters_info[i].decoder_buffer_delay, br, n);
-                    _obp_br(seq_header->operating_parameters_info[i].encoder_buffer_delay, br, n);
-                    _obp_br(seq_header->operating_parameters_info[i].low_delay_mode_flag, br, 1);
-                }
-            } else {
-                seq_header->decoder_model_present_for_this_op[i] = 0;
-            }
-            if (seq_header->initial_display_delay_present_flag) {
-                _obp_br(seq_header->initial_display_delay_present_for_this_op[i], br, 1);
-                if (seq_header->initial_display_delay_present_for_this_op[i]) {
-                    _obp_br(seq_header->initial_display_delay_minus_1[i], br, 4);
-                }
-            }
-        }
-    }
-    _obp_br(seq_header->frame_width_bits_minus_1, br, 4);
-    _obp_br(seq_header->frame_height_bits_minus_1, br, 4);
-    _obp_br(seq_header->max_frame_width_minus_1, br, seq_header->frame_width_bits_minus_1 + 1);
-    _obp_br(seq_header->max_frame_height_minus_1, br, seq_header->frame_height_bits_minus_1 + 1);
-    if (seq_header->reduced_still_picture_header) {
-        seq_header->frame_id_numbers_present_flag = 0;
-    } else {
-        _obp_br(seq_header->frame_id_numbers_present_flag, br, 1);
+    if (_obp_leb128(buf, buf_size, &value, &consumed, err) < 0) {
+        err->element = element;
+        return -1;
     }
-    if (seq_header->frame_id_numbers_present_flag) {
-        _obp_br(seq_header->delta_frame_id_length_minus_2, br, 4);
-        _obp_br(seq_header->additional_frame_id_length_minus_1, br, 3);
+
+    if (value > buf_size - (size_t) consumed) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, element, 0, "Invalid %s: %"PRIu64" is larger than remaining buffer (%zu).",
+                   element, value, buf_size - (size_t) consumed);
+        return -1;
     }
-    _obp_br(seq_header->use_128x128_superblock, br, 1);
-    _obp_br(seq_header->enable_filter_intra, br, 1);
-    _obp_br(seq_header->enable_intra_edge_filter, br, 1);
-    if (seq_header->reduced_still_picture_header) {
-        seq_header->enable_interintra_compound     = 0;
-        seq_header->enable_masked_compound         = 0;
-        seq_header->enable_warped_motion           = 0;
-        seq_header->enable_dual_filter             = 0;
-        seq_header->enable_order_hint              = 0;
-        seq_header->enable_jnt_comp                = 0;
-        seq_header->enable_ref_frame_mvs           = 0;
-        seq_header->seq_force_screen_content_tools = 2; /* SELECT_SCREEN_CONTENT_TOOLS */
-        seq_header->seq_force_integer_mv           = 2; /* SELECT_INTEGER_MV */
-        seq_header->OrderHintBits                  = 0;
-    } else {
-        _obp_br(seq_header->enable_interintra_compound, br, 1);
-        _obp_br(seq_header->enable_masked_compound, br, 1);
-        _obp_br(seq_header->enable_warped_motion, br, 1);
-        _obp_br(seq_header->enable_dual_filter, br, 1);
-        _obp_br(seq_header->enable_order_hint, br, 1);
-        if (seq_header->enable_order_hint) {
-            _obp_br(seq_header->enable_jnt_comp, br, 1);
-            _obp_br(seq_header->enable_ref_frame_mvs, br, 1);
-        } else {
-            seq_header->enable_jnt_comp = 0;
-            seq_header->enable_ref_frame_mvs = 0;
-        }
-        _obp_br(seq_header->seq_choose_screen_content_tools, br, 1);
-        if (seq_header->seq_choose_screen_content_tools) {
-            seq_header->seq_force_screen_content_tools = 2; /* SELECT_SCREEN_CONTENT_TOOLS */
-        } else {
-            _obp_br(seq_header->seq_force_screen_content_tools, br, 1);
-        }
-        if (seq_header->seq_force_screen_content_tools > 0) {
-            _obp_br(seq_header->seq_choose_integer_mv, br, 1);
-            if (seq_header->seq_choose_integer_mv) {
-                seq_header->seq_force_integer_mv = 2; /* SELECT_INTEGER_MV */
-            } else {
-                _obp_br(seq_header->seq_force_integer_mv, br, 1);
-            }
-        } else {
-            seq_header->seq_force_integer_mv = 2; /* SELECT_INTEGER_MV */
-        }
-        if (seq_header->enable_order_hint) {
-            _obp_br(seq_header->order_hint_bits_minus_1, br, 3);
-            seq_header->OrderHintBits = seq_header->order_hint_bits_minus_1 + 1;
-        } else {
-            seq_header->OrderHintBits = 0;
-        }
-    }
-    _obp_br(seq_header->enable_superres, br, 1);
-    _obp_br(seq_header->enable_cdef, br, 1);
-    _obp_br(seq_header->enable_restoration, br, 1);
-    /* color_config() */
-    _obp_br(seq_header->color_config.high_bitdepth, br, 1);
-    if (seq_header->seq_profile == 2 && seq_header->color_config.high_bitdepth) {
-        _obp_br(seq_header->color_config.twelve_bit, br, 1);
-        seq_header->color_config.BitDepth = seq_header->color_config.twelve_bit ? 12 : 10;
-    } else {
-        seq_header->color_config.BitDepth = seq_header->color_config.high_bitdepth ? 10 : 8;
-    }
-    if (seq_header->seq_profile == 1) {
-        seq_header->color_config.mono_chrome = 0;
-    } else {
-        _obp_br(seq_header->color_config.mono_chrome, br, 1);
-    }
-    seq_header->color_config.NumPlanes = seq_header->color_config.mono_chrome ? 1 : 3;
-    _obp_br(seq_header->color_config.color_description_present_flag, br, 1);
-    if (seq_header->color_config.color_description_present_flag) {
-        _obp_br(seq_header->color_config.color_primaries, br, 8);
-        _obp_br(seq_header->color_config.transfer_characteristics, br, 8);
-        _obp_br(seq_header->color_config.matrix_coefficients, br, 8);
-    } else {
-        seq_header->color_config.color_primaries          = OBP_CP_UNSPECIFIED;
-        seq_header->color_config.transfer_characteristics = OBP_TC_UNSPECIFIED;
-        seq_header->color_config.matrix_coefficients      = OBP_MC_UNSPECIFIED;
-    }
-    if (seq_header->color_config.mono_chrome) {
-        _obp_br(seq_header->color_config.color_range, br, 1);
-        seq_header->color_config.subsampling_x          = 1;
-        seq_header->color_config.subsampling_y          = 1;
-        seq_header->color_config.chroma_sample_position = OBP_CSP_UNKNOWN;
-        seq_header->color_config.separate_uv_delta_q    = 0;
-        goto color_done;
-    } else if (seq_header->color_config.color_primaries == OBP_CP_BT_709 &&
-               seq_header->color_config.transfer_characteristics == OBP_TC_SRGB &&
-               seq_header->color_config.matrix_coefficients == OBP_MC_IDENTITY) {
-        seq_header->color_config.color_range = 1;
-        seq_header->color_config.subsampling_x = 0;
-        seq_header->color_config.subsampling_y = 0;
-    } else {
-        _obp_br(seq_header->color_config.color_range, br, 1);
-        if (seq_header->seq_profile == 0) {
-            seq_header->color_config.subsampling_x = 1;
-            seq_header->color_config.subsampling_y = 1;
-        } else if (seq_header->seq_profile == 1) {
-            seq_header->color_config.subsampling_x = 0;
-            seq_header->color_config.subsampling_y = 0;
-        } else {
-            if (seq_header->color_config.BitDepth == 12) {
-                _obp_br(seq_header->color_config.subsampling_x, br, 1);
-                if (seq_header->color_config.subsampling_x) {
-                    _obp_br(seq_header->color_config.subsampling_y, br, 1);
-                } else {
-                    seq_header->color_config.subsampling_y = 0;
-                }
-            } else {
-                seq_header->color_config.subsampling_x = 1;
-                seq_header->color_config.subsampling_y = 0;
-            }
-        }
-        if (seq_header->color_config.subsampling_x && seq_header->color_config.subsampling_y) {
-            _obp_br(seq_header->color_config.chroma_sample_position, br, 2);
-        }
-    }
-    _obp_br(seq_header->color_config.separate_uv_delta_q, br, 1);
 
-color_done:
-    _obp_br(seq_header->film_grain_params_present, br, 1);
+    *offset    = consumed;
+    *unit_size = (size_t) value;
 
     return 0;
 }
 
-int obp_parse_tile_list(uint8_t *buf, size_t buf_size, OBPTileList *tile_list, OBPError *err)
+/*
+ * Works out the total size of an OBU, including its header, from its first bytes.
+ * Returns 1 if it could be determined, 0 if more bytes are needed, and -1 on error.
+ */
+static inline int _obp_get_obu_total_size(uint8_t *buf, size_t buf_size, size_t *total_size, OBPError *err)
 {
-    size_t pos = 0;
+    size_t pos = 1;
+    uint64_t value;
+    ptrdiff_t consumed;
 
-    if (buf_size < 4) {
-        snprintf(err->error, err->size, "Tile list OBU must be at least 4 bytes.");
+    if (buf_size < 1)
+        return 0;
+
+    if (buf[0] & 0x80) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "obu_forbidden_bit", 0, "OBU header has forbidden bit set.");
         return -1;
     }
 
-    tile_list->output_frame_width_in_tiles_minus_1  = buf[0];
-    tile_list->output_frame_height_in_tiles_minus_1 = buf[1];
-    tile_list->tile_count_minus_1                   = (((uint16_t) buf[2]) << 8) | buf[3];
-    pos += 4;
+    if (!(buf[0] & 0x02)) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "obu_has_size_field", 6,
+                   "OBU without a size field cannot be assembled from a stream.");
+        return -1;
+    }
 
-    for (uint16_t i = 0; i < tile_list->tile_count_minus_1; i++) {
-        if (pos + 5 > buf_size) {
-            snprintf(err->error, err->size, "Tile list OBU malformed: Not enough bytes for next tile_list_entry().");
-            return -1;
-        }
+    pos += (buf[0] & 0x04) >> 2;
 
-        tile_list->tile_list_entry[i].anchor_frame_idx       = buf[pos];
-        tile_list->tile_list_entry[i].anchor_tile_row        = buf[pos + 1];
-        tile_list->tile_list_entry[i].anchor_tile_col        = buf[pos + 2];
-        tile_list->tile_list_entry[i].tile_data_size_minus_1 = (((uint16_t) buf[pos + 3]) << 8) | buf[pos + 4];
-        pos += 5;
+    /* A leb128 value is complete once a byte without the continuation bit is seen, or after 8 bytes. */
+    for (size_t i = pos; ; i++) {
+        if (i >= buf_size)
+            return 0;
+        if (!(buf[i] & 0x80) || i - pos == 7)
+            break;
+    }
 
-        size_t N = 8 * (((size_t) tile_list->tile_list_entry[i].tile_data_size_minus_1) + 1);
+    if (_obp_leb128(buf + pos, buf_size - pos, &value, &consumed, err) < 0)
+        return -1;
 
-        if (pos + N > buf_size) {
-            snprintf(err->error, err->size, "Tile list OBU malformed: Not enough bytes for next tile_list_entry()'s data.");
-            return -1;
-        }
+    if (value > SIZE_MAX - pos - (size_t) consumed) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "obu_size", pos * 8, "Invalid OBU size: %"PRIu64".", value);
+        return -1;
+    }
+
+    *total_size = pos + (size_t) consumed + (size_t) value;
+
+    return 1;
+}
+
+static inline int _obp_assembler_emit(uint8_t *buf, size_t size, OBPAssembledOBU *obu, OBPError *err)
+{
+    ptrdiff_t offset;
 
-        tile_list->tile_list_entry[i].coded_tile_data      = buf + pos;
-        tile_list->tile_list_entry[i].coded_tile_data_size = N;
-        pos += N;
+    if (_obp_get_next_obu(buf, size, &obu->obu_type, &offset, &obu->obu_size, &obu->temporal_id,
+                          &obu->spatial_id, err) < 0)
+        return -1;
+
+    obu->temporal_unit_start = (obu->obu_type == OBP_OBU_TEMPORAL_DELIMITER);
+    obu->obu                 = buf;
+    obu->obu_size_total      = size;
+    obu->payload             = buf + offset;
+
+    return 1;
+}
+
+static inline unsigned int _obp_ctz64(uint64_t x)
+{
+#if defined(__GNUC__)
+    return (unsigned int) __builtin_ctzll(x);
+#else
+    unsigned int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
     }
+    return n;
+#endif
+}
 
-    return 0;
+/*
+ * Returns the position of the first 0x12 0x00 byte pair (a temporal delimiter OBU
+ * with obu_has_size_field set and a zero size) at or after pos, or buf_size if
+ * there is none. Two overlapping loads are compared per block, so no carry between
+ * blocks is needed.
+ */
+static inline size_t _obp_find_td_candidate(uint8_t *buf, size_t buf_size, size_t pos)
+{
+#if defined(__AVX2__)
+    const __m256i avx_hdr  = _mm256_set1_epi8(0x12);
+    const __m256i avx_zero = _mm256_setzero_si256();
+    while (buf_size - pos >= 33) {
+        __m256i a     = _mm256_loadu_si256((const __m256i *) (buf + pos));
+        __m256i b     = _mm256_loadu_si256((const __m256i *) (buf + pos + 1));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, avx_hdr),
+                                                                         _mm256_cmpeq_epi8(b, avx_zero)));
+        if (mask)
+            return pos + _obp_ctz64(mask);
+        pos += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i sse_hdr  = _mm_set1_epi8(0x12);
+    const __m128i sse_zero = _mm_setzero_si128();
+    while (buf_size - pos >= 17) {
+        __m128i a     = _mm_loadu_si128((const __m128i *) (buf + pos));
+        __m128i b     = _mm_loadu_si128((const __m128i *) (buf + pos + 1));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, sse_hdr),
+                                                                   _mm_cmpeq_epi8(b, sse_zero)));
+        if (mask)
+            return pos + _obp_ctz64(mask);
+        pos += 16;
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t neon_hdr  = vdupq_n_u8(0x12);
+    const uint8x16_t neon_zero = vdupq_n_u8(0x00);
+    while (buf_size - pos >= 17) {
+        uint8x16_t a  = vld1q_u8(buf + pos);
+        uint8x16_t b  = vld1q_u8(buf + pos + 1);
+        uint8x16_t eq = vandq_u8(vceqq_u8(a, neon_hdr), vceqq_u8(b, neon_zero));
+        /* Narrow to 4 bits per byte, as NEON has no movemask. */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (mask)
+            return pos + (_obp_ctz64(mask) >> 2);
+        pos += 16;
+    }
+#endif
+    while (buf_size - pos >= 2) {
+        uint8_t *hit = memchr(buf + pos, 0x12, buf_size - pos - 1);
+        if (hit == NULL)
+            break;
+        pos = (size_t) (hit - buf);
+        if (buf[pos + 1] == 0x00)
+            return pos;
+        pos++;
+    }
+
+    return buf_size;
 }
 
-int obp_parse_tile_group(uint8_t *buf, size_t buf_size, OBPFrameHeader *frame_header, OBPTileGroup *tile_group,
-                         int *SeenFrameHeader, OBPError *err)
+
+/*
+ * Tile offsets are stored relative to buf - base, so that obp_parse_frame can report them
+ * relative to the start of the frame OBU.
+ */
+static inline int _obp_parse_tile_group(uint8_t *buf, size_t buf_size, size_t base, OBPFrameHeader *frame_header,
+                                        OBPTileGroup *tile_group, int header_only, int *SeenFrameHeader, OBPError *err)
 {
     _OBPBitReader b   = _obp_new_br(buf, buf_size);
     _OBPBitReader *br = &b;
 
+    if (base + buf_size > UINT32_MAX) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Tile group is too large: %zu bytes.", base + buf_size);
+        return -1;
+    }
+
     tile_group->NumTiles                        = frame_header->tile_info.TileCols * frame_header->tile_info.TileRows;
     size_t startBitPos                          = 0;
     tile_group->tile_start_and_end_present_flag = 0;
@@ -834,28 +1114,49 @@ int obp_parse_tile_group(uint8_t *buf, size_t buf_size, OBPFrameHeader *frame_he
     size_t sz          = buf_size - headerBytes;
     size_t pos         = headerBytes;
 
+    /* The header is enough to know whether this tile group ends the frame. */
+    if (header_only)
+        goto end;
+
+    if ((tile_group->TileSize != NULL || tile_group->TileOffset != NULL) && tile_group->tg_end >= tile_group->tg_start &&
+        ((size_t) (tile_group->tg_end - tile_group->tg_start)) + 1 > tile_group->TileCapacity) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, endBitPos,
+                   "Tile arrays are too small: %zu entries for %d tiles.", tile_group->TileCapacity,
+                   tile_group->tg_end - tile_group->tg_start + 1);
+        return -1;
+    }
+
     for (uint16_t TileNum = tile_group->tg_start; TileNum <= tile_group->tg_end; TileNum++) {
         /* tileRow = TileNum / TileCols */
         /* tileCol = TileNum % TileCols */
         int lastTile     = (TileNum == tile_group->tg_end);
+        size_t tileStart = pos;
+        uint32_t tileSize;
         if (lastTile) {
-            tile_group->TileSize[TileNum] = sz;
+            tileSize = (uint32_t) sz;
         } else {
             uint16_t TileSizeBytes = frame_header->tile_info.tile_size_bytes_minus_1 + 1;
             uint64_t tile_size_minus_1;
             if (sz < TileSizeBytes) {
-                snprintf(err->error, err->size, "Not enough bytes left to read tile size for tile %"PRIu16".", TileNum);
+                _obp_error(err, OBP_ERROR_OUT_OF_DATA, "tile_size_minus_1", pos * 8,
+                           "Not enough bytes left to read tile size for tile %"PRIu16".", TileNum);
                 return -1;
             }
-            tile_size_minus_1             = _obp_le(buf + pos, TileSizeBytes);
-            tile_group->TileSize[TileNum] = tile_size_minus_1 + 1;
-            if (sz < tile_group->TileSize[TileNum]) {
-                snprintf(err->error, err->size, "Not enough bytes to contain TileSize for tile %"PRIu16".", TileNum);
+            tile_size_minus_1 = _obp_le(buf + pos, TileSizeBytes);
+            if (sz - TileSizeBytes <= tile_size_minus_1) {
+                _obp_error(err, OBP_ERROR_OUT_OF_DATA, "tile_size_minus_1", pos * 8,
+                           "Not enough bytes to contain TileSize for tile %"PRIu16".", TileNum);
                 return -1;
             }
-            sz  -= tile_group->TileSize[TileNum] + TileSizeBytes;
-            pos += tile_group->TileSize[TileNum] + TileSizeBytes;
+            tileSize   = (uint32_t) tile_size_minus_1 + 1;
+            tileStart += TileSizeBytes;
+            sz        -= tileSize + TileSizeBytes;
+            pos       += tileSize + TileSizeBytes;
         }
+        if (tile_group->TileSize != NULL)
+            tile_group->TileSize[TileNum - tile_group->tg_start] = tileSize;
+        if (tile_group->TileOffset != NULL)
+            tile_group->TileOffset[TileNum - tile_group->tg_start] = (uint32_t) (base + tileStart);
         /* MiRowStart = MiRowStarts[ tileRow ] */
         /* MiRowEnd = MiRowStarts[ tileRow + 1 ] */
         /* MiColStart = MiColStarts[ tileCol ] */
@@ -865,6 +1166,7 @@ int obp_parse_tile_group(uint8_t *buf, size_t buf_size, OBPFrameHeader *frame_he
         /* decode_tile( ) */
         /* exit_symbol( ) */
     }
+end:
     if (tile_group->tg_end == tile_group->NumTiles - 1) {
         /* if ( !disable_frame_end_update_cdf ) {
                frame_end_update_cdf( )
@@ -877,179 +1179,1471 @@ int obp_parse_tile_group(uint8_t *buf, size_t buf_size, OBPFrameHeader *frame_he
     return 0;
 }
 
-int obp_parse_metadata(uint8_t *buf, size_t buf_size, OBPMetadata *metadata, OBPError *err)
+
+/* The current entry is never evicted, so at least one other is needed. */
+typedef char _obp_seq_cache_size_check[(OBP_SEQUENCE_HEADER_CACHE_ENTRIES >= 2) ? 1 : -1];
+
+/* 64-bit FNV-1a, used to key the sequence header cache. */
+static inline uint64_t _obp_fnv1a(uint8_t *buf, size_t size)
 {
-    uint64_t val;
-    ptrdiff_t consumed;
-    char err_buf[1024];
-    _OBPBitReader b;
-    _OBPBitReader *br;
-    OBPError error = { &err_buf[0], 1024 };
+    uint64_t hash = 0xCBF29CE484222325;
 
-    int ret = _obp_leb128(buf, buf_size, &val, &consumed, &error);
-    if (ret < 0) {
-        snprintf(err->error, err->size, "Couldn't read metadata type: %s", error.error);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= buf[i];
+        hash *= 0x00000100000001B3;
+    }
+
+    return hash;
+}
+
+/*
+ * OBPState snapshots. Everything is written little-endian, one reference slot at a time.
+ * Optional parts of each slot (non-identity global motion, enabled segmentation features,
+ * and applied film grain) are only written when present.
+ */
+#define _OBP_SNAPSHOT_VERSION 2
+#define _OBP_SNAPSHOT_HEADER_MAX_SIZE (1 + 3 + 8)
+#define _OBP_SNAPSHOT_GRAIN_MAX_SIZE (1 + 2 + 1 + 3 * (1 + 16 * 2) + 1 + 1 + 24 + 25 + 25 + 1 + 1 + 1 + 1 + 2 + 1 + 1 + 2)
+#define _OBP_SNAPSHOT_SLOT_MAX_SIZE (1 + 1 + 2 + 4 * 5 + 1 + 7 * 6 * 4 + 8 + 8 * 8 * 2 + 8 + 8 + 2 + _OBP_SNAPSHOT_GRAIN_MAX_SIZE)
+
+typedef char _obp_snapshot_size_check[(_OBP_SNAPSHOT_HEADER_MAX_SIZE + 8 * _OBP_SNAPSHOT_SLOT_MAX_SIZE ==
+                                       OBP_STATE_SNAPSHOT_MAX_SIZE) ? 1 : -1];
+
+static inline void _obp_put_le(uint8_t *buf, size_t *pos, uint64_t value, uint8_t n)
+{
+    for (uint8_t i = 0; i < n; i++) {
+        buf[*pos] = (uint8_t) (value >> (i * 8));
+        (*pos)++;
+    }
+}
+
+static inline void _obp_put_be(uint8_t *buf, size_t *pos, uint64_t value, uint8_t n)
+{
+    for (uint8_t i = 0; i < n; i++) {
+        buf[*pos] = (uint8_t) (value >> ((n - 1 - i) * 8));
+        (*pos)++;
+    }
+}
+
+static inline void _obp_put_leb128(uint8_t *buf, size_t *pos, uint64_t value)
+{
+    do {
+        buf[*pos] = (uint8_t) ((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+        value   >>= 7;
+        (*pos)++;
+    } while (value != 0);
+}
+
+static inline size_t _obp_leb128_size(uint64_t value)
+{
+    size_t n = 1;
+    while (value > 0x7F) {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+#define _obp_snap_get(x, n) do { \
+    if (buf_size - pos < (n)) { \
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, #x, pos * 8, "Ran out of bytes in state snapshot."); \
+        return -1; \
+    } \
+    x    = _obp_le(buf + pos, n); \
+    pos += (n); \
+} while(0)
+
+#define _obp_snap_get_leb128(x) do { \
+    uint64_t value; \
+    ptrdiff_t consumed; \
+    if (_obp_leb128(buf + pos, buf_size - pos, &value, &consumed, err) < 0) { \
+        err->element  = #x; \
+        err->bit_pos += pos * 8; \
+        return -1; \
+    } \
+    x    = (uint32_t) value; \
+    pos += (size_t) consumed; \
+} while(0)
+
+static inline void _obp_put_grain_params(uint8_t *buf, size_t *pos, OBPFilmGrainParameters *g)
+{
+    uint8_t flags = (uint8_t) ((!!g->apply_grain) | ((!!g->update_grain) << 1) | ((!!g->chroma_scaling_from_luma) << 2) |
+                               ((!!g->overlap_flag) << 3) | ((!!g->clip_to_restricted_range) << 4));
+    uint8_t num_y  = _OBP_MIN(g->num_y_points, 16);
+    uint8_t num_cb = _OBP_MIN(g->num_cb_points, 16);
+    uint8_t num_cr = _OBP_MIN(g->num_cr_points, 16);
+
+    _obp_put_le(buf, pos, flags, 1);
+    _obp_put_le(buf, pos, g->grain_seed, 2);
+    _obp_put_le(buf, pos, g->film_grain_params_ref_idx, 1);
+    _obp_put_le(buf, pos, num_y, 1);
+    for (uint8_t i = 0; i < num_y; i++) {
+        _obp_put_le(buf, pos, g->point_y_value[i], 1);
+        _obp_put_le(buf, pos, g->point_y_scaling[i], 1);
+    }
+    _obp_put_le(buf, pos, num_cb, 1);
+    for (uint8_t i = 0; i < num_cb; i++) {
+        _obp_put_le(buf, pos, g->point_cb_value[i], 1);
+        _obp_put_le(buf, pos, g->point_cb_scaling[i], 1);
+    }
+    _obp_put_le(buf, pos, num_cr, 1);
+    for (uint8_t i = 0; i < num_cr; i++) {
+        _obp_put_le(buf, pos, g->point_cr_value[i], 1);
+        _obp_put_le(buf, pos, g->point_cr_scaling[i], 1);
+    }
+    _obp_put_le(buf, pos, g->grain_scaling_minus_8, 1);
+    _obp_put_le(buf, pos, g->ar_coeff_lag, 1);
+    memcpy(buf + *pos, g->ar_coeffs_y_plus_128, 24);
+    memcpy(buf + *pos + 24, g->ar_coeffs_cb_plus_128, 25);
+    memcpy(buf + *pos + 49, g->ar_coeffs_cr_plus_128, 25);
+    *pos += 74;
+    _obp_put_le(buf, pos, g->ar_coeff_shift_minus_6, 1);
+    _obp_put_le(buf, pos, g->grain_scale_shift, 1);
+    _obp_put_le(buf, pos, g->cb_mult, 1);
+    _obp_put_le(buf, pos, g->cb_luma_mult, 1);
+    _obp_put_le(buf, pos, g->cb_offset, 2);
+    _obp_put_le(buf, pos, g->cr_mult, 1);
+    _obp_put_le(buf, pos, g->cr_luma_mult, 1);
+    _obp_put_le(buf, pos, g->cr_offset, 2);
+}
+
+static inline int _obp_get_grain_params(uint8_t *buf, size_t buf_size, size_t *posp, OBPFilmGrainParameters *g,
+                                        OBPError *err)
+{
+    size_t pos = *posp;
+    uint8_t flags;
+
+    memset(g, 0, sizeof(*g));
+
+    _obp_snap_get(flags, 1);
+    g->apply_grain              = flags & 1;
+    g->update_grain             = (flags >> 1) & 1;
+    g->chroma_scaling_from_luma = (flags >> 2) & 1;
+    g->overlap_flag             = (flags >> 3) & 1;
+    g->clip_to_restricted_range = (flags >> 4) & 1;
+    _obp_snap_get(g->grain_seed, 2);
+    _obp_snap_get(g->film_grain_params_ref_idx, 1);
+    _obp_snap_get(g->num_y_points, 1);
+    if (g->num_y_points > 16) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "num_y_points", pos * 8, "Invalid num_y_points in state snapshot: %"PRIu8".",
+                   g->num_y_points);
         return -1;
     }
-    metadata->metadata_type = val;
+    for (uint8_t i = 0; i < g->num_y_points; i++) {
+        _obp_snap_get(g->point_y_value[i], 1);
+        _obp_snap_get(g->point_y_scaling[i], 1);
+    }
+    _obp_snap_get(g->num_cb_points, 1);
+    if (g->num_cb_points > 16) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "num_cb_points", pos * 8, "Invalid num_cb_points in state snapshot: %"PRIu8".",
+                   g->num_cb_points);
+        return -1;
+    }
+    for (uint8_t i = 0; i < g->num_cb_points; i++) {
+        _obp_snap_get(g->point_cb_value[i], 1);
+        _obp_snap_get(g->point_cb_scaling[i], 1);
+    }
+    _obp_snap_get(g->num_cr_points, 1);
+    if (g->num_cr_points > 16) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "num_cr_points", pos * 8, "Invalid num_cr_points in state snapshot: %"PRIu8".",
+                   g->num_cr_points);
+        return -1;
+    }
+    for (uint8_t i = 0; i < g->num_cr_points; i++) {
+        _obp_snap_get(g->point_cr_value[i], 1);
+        _obp_snap_get(g->point_cr_scaling[i], 1);
+    }
+    _obp_snap_get(g->grain_scaling_minus_8, 1);
+    _obp_snap_get(g->ar_coeff_lag, 1);
+    if (buf_size - pos < 74) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, "ar_coeffs_y_plus_128", pos * 8, "Ran out of bytes in state snapshot.");
+        return -1;
+    }
+    memcpy(g->ar_coeffs_y_plus_128, buf + pos, 24);
+    memcpy(g->ar_coeffs_cb_plus_128, buf + pos + 24, 25);
+    memcpy(g->ar_coeffs_cr_plus_128, buf + pos + 49, 25);
+    pos += 74;
+    _obp_snap_get(g->ar_coeff_shift_minus_6, 1);
+    _obp_snap_get(g->grain_scale_shift, 1);
+    _obp_snap_get(g->cb_mult, 1);
+    _obp_snap_get(g->cb_luma_mult, 1);
+    _obp_snap_get(g->cb_offset, 2);
+    _obp_snap_get(g->cr_mult, 1);
+    _obp_snap_get(g->cr_luma_mult, 1);
+    _obp_snap_get(g->cr_offset, 2);
 
-    b  = _obp_new_br(buf + consumed, buf_size - consumed);
-    br = &b;
+    *posp = pos;
 
-    if (metadata->metadata_type == OBP_METADATA_TYPE_HDR_CLL) {
-        _obp_br(metadata->metadata_hdr_cll.max_cll, br, 16);
-        _obp_br(metadata->metadata_hdr_cll.max_fall, br, 16);
-    } else if (metadata->metadata_type == OBP_METADATA_TYPE_HDR_MDCV) {
-        for (int i = 0; i < 3; i++) {
-            _obp_br(metadata->metadata_hdr_mdcv.primary_chromaticity_x[i], br, 16);
-            _obp_br(metadata->metadata_hdr_mdcv.primary_chromaticity_y[i], br, 16);
-        }
-        _obp_br(metadata->metadata_hdr_mdcv.white_point_chromaticity_x, br, 16);
-        _obp_br(metadata->metadata_hdr_mdcv.white_point_chromaticity_y, br, 16);
-        _obp_br(metadata->metadata_hdr_mdcv.luminance_max, br, 32);
-        _obp_br(metadata->metadata_hdr_mdcv.luminance_min, br, 32);
-    } else if (metadata->metadata_type == OBP_METADATA_TYPE_SCALABILITY) {
-        _obp_br(metadata->metadata_scalability.scalability_mode_idc, br, 8);
-        if (metadata->metadata_scalability.scalability_mode_idc) {
-            /* scalability_structure() */
-            _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layers_cnt_minus_1, br, 2);
-            _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_dimensions_present_flag, br, 1);
-            _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_description_present_flag, br, 1);
-            _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_description_present_flag, br, 1);
-            _obp_br(metadata->metadata_scalability.scalability_structure.scalability_structure_reserved_3bits, br, 3);
-            if (metadata->metadata_scalability.scalability_structure.spatial_layer_dimensions_present_flag) {
-                for (uint8_t i = 0; i < metadata->metadata_scalability.scalability_structure.spatial_layers_cnt_minus_1; i++) {
-                    _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_max_width[i], br, 16);
-                    _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_max_height[i], br, 16);
-                }
-            }
-            if (metadata->metadata_scalability.scalability_structure.spatial_layer_description_present_flag) {
-                for (uint8_t i = 0; i < metadata->metadata_scalability.scalability_structure.spatial_layers_cnt_minus_1; i++) {
-                    _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_ref_id[i], br, 8);
-                }
-            }
-            if (metadata->metadata_scalability.scalability_structure.temporal_group_description_present_flag) {
-                _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_size, br, 8);
-                for (uint8_t i = 0; i < metadata->metadata_scalability.scalability_structure.temporal_group_size; i++) {
-                    _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_temporal_id[i], br, 3);
-                    _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_temporal_switching_up_point_flag[i], br, 1);
-                    _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_spatial_switching_up_point_flag[i], br, 1);
-                    _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_ref_cnt[i], br, 3);
-                    for (uint8_t j = 0; j < metadata->metadata_scalability.scalability_structure.temporal_group_ref_cnt[i]; j++) {
-                        _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_ref_pic_diff[i][j], br, 8);
-                    }
+    return 0;
+}
+
+/*
+ * The size of the VisualSampleEntry fields before its child boxes, and of an 'nclx' type
+ * 'colr' box.
+ */
+#define _OBP_VISUAL_SAMPLE_ENTRY_SIZE 78
+#define _OBP_COLR_BOX_SIZE (8 + 4 + 2 + 2 + 2 + 1)
+
+/*
+ * Locates the payload of a sequence header OBU, and returns the size of the AV1 codec
+ * configuration record which contains it.
+ */
+static inline int _obp_get_av1c_size(uint8_t *obu, size_t obu_size, ptrdiff_t *offset, size_t *payload_size,
+                                     size_t *av1c_size, OBPError *err)
+{
+    OBPOBUType obu_type;
+    int temporal_id, spatial_id;
+
+    int ret = _obp_get_next_obu(obu, obu_size, &obu_type, offset, payload_size, &temporal_id, &spatial_id, err);
+    if (ret < 0)
+        return -1;
+
+    if (obu_type != OBP_OBU_SEQUENCE_HEADER) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, "obu_type", 1, "OBU is not a sequence header: type %d.", obu_type);
+        return -1;
+    }
+
+    *av1c_size = 4 + 1 + ((obu[0] & 0x04) >> 2) + _obp_leb128_size(*payload_size) + *payload_size;
+
+    return 0;
+}
+
+static inline void _obp_put_av1c(OBPSequenceHeader *seq, uint8_t *obu, ptrdiff_t offset, size_t payload_size,
+                                 uint8_t *buf, size_t *pos)
+{
+    int twelve_bit     = seq->seq_profile == 2 && seq->color_config.high_bitdepth && seq->color_config.twelve_bit;
+    int has_csp        = !seq->color_config.mono_chrome && seq->color_config.subsampling_x &&
+                         seq->color_config.subsampling_y;
+    int has_init_delay = seq->initial_display_delay_present_flag && seq->initial_display_delay_present_for_this_op[0];
+
+    _obp_put_be(buf, pos, 0x81, 1); /* marker, version */
+    _obp_put_be(buf, pos, ((uint32_t) seq->seq_profile << 5) | (seq->seq_level_idx[0] & 0x1F), 1);
+    _obp_put_be(buf, pos, ((uint32_t) (seq->seq_tier[0] & 1) << 7) |
+                          ((uint32_t) (seq->color_config.high_bitdepth & 1) << 6) |
+                          ((uint32_t) twelve_bit << 5) |
+                          ((uint32_t) (seq->color_config.mono_chrome & 1) << 4) |
+                          ((uint32_t) (seq->color_config.subsampling_x & 1) << 3) |
+                          ((uint32_t) (seq->color_config.subsampling_y & 1) << 2) |
+                          (has_csp ? (uint32_t) seq->color_config.chroma_sample_position & 3 : 0), 1);
+    _obp_put_be(buf, pos, has_init_delay ? 0x10 | (seq->initial_display_delay_minus_1[0] & 0x0F) : 0, 1);
+
+    /* configOBUs: the OBU header with obu_has_size_field set, then the size, then the payload. */
+    _obp_put_be(buf, pos, obu[0] | 0x02, 1);
+    if (obu[0] & 0x04)
+        _obp_put_be(buf, pos, obu[1], 1);
+    _obp_put_leb128(buf, pos, payload_size);
+    memcpy(buf + *pos, obu + offset, payload_size);
+    *pos += payload_size;
+}
+
+/*
+ * Level limits from Annex A, indexed by seq_level_idx. Undefined levels have a zero
+ * MaxPicSize. Bitrates are in units of 100 kbps, and levels without a high tier have a
+ * zero HighMbps.
+ */
+static const struct {
+    uint32_t MaxPicSize;
+    uint16_t MaxHSize;
+    uint16_t MaxVSize;
+    uint64_t MaxDisplayRate;
+    uint64_t MaxDecodeRate;
+    uint16_t MaxHeaderRate;
+    uint16_t MainMbps;
+    uint16_t HighMbps;
+    uint8_t MainCR;
+    uint8_t HighCR;
+    uint8_t MaxTiles;
+    uint8_t MaxTileCols;
+} _obp_levels[24] = {
+    /*  0 */ { 147456, 2048, 1152, 4423680, 5529600, 150, 15, 0, 2, 0, 8, 4 },
+    /*  1 */ { 278784, 2816, 1584, 8363520, 10454400, 150, 30, 0, 2, 0, 8, 4 },
+    /*  2 */ { 0 },
+    /*  3 */ { 0 },
+    /*  4 */ { 665856, 4352, 2448, 19975680, 24969600, 150, 60, 0, 2, 0, 16, 6 },
+    /*  5 */ { 1065024, 5504, 3096, 31950720, 39938400, 150, 100, 0, 2, 0, 16, 6 },
+    /*  6 */ { 0 },
+    /*  7 */ { 0 },
+    /*  8 */ { 2359296, 6144, 3456, 70778880, 77856768, 300, 120, 300, 4, 4, 32, 8 },
+    /*  9 */ { 2359296, 6144, 3456, 141557760, 155713536, 300, 200, 500, 4, 4, 32, 8 },
+    /* 10 */ { 0 },
+    /* 11 */ { 0 },
+    /* 12 */ { 8912896, 8192, 4352, 267386880, 273715200, 300, 300, 1000, 6, 4, 64, 8 },
+    /* 13 */ { 8912896, 8192, 4352, 534773760, 547430400, 300, 400, 1600, 8, 4, 64, 8 },
+    /* 14 */ { 8912896, 8192, 4352, 1069547520, 1094860800, 300, 600, 2400, 8, 4, 64, 8 },
+    /* 15 */ { 8912896, 8192, 4352, 1069547520, 1176502272, 300, 600, 2400, 8, 4, 64, 8 },
+    /* 16 */ { 35651584, 16384, 8704, 1069547520, 1176502272, 300, 600, 2400, 8, 4, 128, 16 },
+    /* 17 */ { 35651584, 16384, 8704, 2139095040, 2189721600, 300, 1000, 4800, 8, 4, 128, 16 },
+    /* 18 */ { 35651584, 16384, 8704, 4278190080, 4379443200, 300, 1600, 8000, 8, 4, 128, 16 },
+    /* 19 */ { 35651584, 16384, 8704, 4278190080, 4706009088, 300, 1600, 8000, 8, 4, 128, 16 },
+    /* 20 */ { 0 },
+    /* 21 */ { 0 },
+    /* 22 */ { 0 },
+    /* 23 */ { 0 }
+};
+
+/* Leeway for comparing times built from rounded timestamps. */
+#define _OBP_LEVEL_TIME_EPSILON 1e-9
+
+/*
+ * Drops frames which are a second or more older than the given time from the verifier's
+ * rate window.
+ */
+static inline void _obp_level_evict(OBPLevelVerifier *v, double time)
+{
+    while (v->window_count > 0 && time - v->window[v->window_start].time >= 1.0 - _OBP_LEVEL_TIME_EPSILON) {
+        v->window_decoded   -= v->window[v->window_start].decoded;
+        v->window_displayed -= v->window[v->window_start].displayed;
+        v->window_start      = (v->window_start + 1) % OBP_LEVEL_WINDOW_FRAMES;
+        v->window_count--;
+    }
+}
+
+/*
+ * Works out when the frame is removed from the smoothing buffer, per the decoder model
+ * if it signals a removal time and a shown key frame has anchored it, and otherwise from
+ * its timestamp.
+ */
+static inline double _obp_level_removal_time(OBPLevelVerifier *v, OBPFrameHeader *fh, int operating_point,
+                                             double time)
+{
+    int is_rap = !fh->show_existing_frame && fh->frame_type == OBP_KEY_FRAME && fh->show_frame;
+    int has_brt = v->decoder_model && !fh->show_existing_frame && fh->buffer_removal_time_present_flag;
+    double removal;
+
+    if (has_brt && v->seen_rap) {
+        uint32_t brt = fh->buffer_removal_time[operating_point];
+
+        /* Removal times strictly increase, so an equal value has wrapped too. */
+        if (brt <= v->last_buffer_removal_time)
+            v->removal_wraps++;
+        v->last_buffer_removal_time = brt;
+
+        removal = v->rap_removal +
+                  (double) (v->removal_wraps * v->buffer_removal_time_modulus + brt) * v->decoding_tick;
+    } else if (v->num_frames == 0) {
+        removal = v->decoder_buffer_delay;
+    } else {
+        removal = v->last_removal + (time - v->last_time);
+    }
+
+    if (has_brt && is_rap) {
+        /* Later buffer_removal_time values count from here. */
+        v->seen_rap                 = 1;
+        v->rap_removal              = removal;
+        v->removal_wraps            = 0;
+        v->last_buffer_removal_time = 0;
+    }
+
+    return removal;
+}
+
+#define _OBP_SEEK_INDEX_VERSION 1
+
+/*
+ * Checks a seek index header, and that the buffer holds all of the points it declares.
+ */
+static inline int _obp_seek_index_check(uint8_t *buf, size_t buf_size, uint64_t *num_points, OBPError *err)
+{
+    if (buf_size < OBP_SEEK_INDEX_HEADER_SIZE) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, NULL, buf_size * 8, "Buffer too small to contain seek index header: %zu bytes.", buf_size);
+        return -1;
+    }
+    if (memcmp(buf, "OBPI", 4) != 0) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "magic", 0, "Invalid seek index magic.");
+        return -1;
+    }
+    if (buf[4] != _OBP_SEEK_INDEX_VERSION) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "version", 32, "Unsupported seek index version: %"PRIu8".", buf[4]);
+        return -1;
+    }
+
+    *num_points = _obp_be(buf + 8, 8);
+
+    if (*num_points > (buf_size - OBP_SEEK_INDEX_HEADER_SIZE) / OBP_SEEK_INDEX_POINT_SIZE) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, NULL, buf_size * 8, "Buffer too small to contain %"PRIu64" seek index points.",
+                   *num_points);
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline void _obp_get_seek_point(uint8_t *buf, uint64_t index, OBPSeekPoint *point)
+{
+    uint8_t *p = buf + OBP_SEEK_INDEX_HEADER_SIZE + index * OBP_SEEK_INDEX_POINT_SIZE;
+
+    point->pts               = (int64_t) _obp_be(p, 8);
+    point->offset            = _obp_be(p + 8, 8);
+    point->forward_key_frame = p[16] & 1;
+}
+
+
+/*****************************
+ * API functions start here. *
+ *****************************/
+
+int obp_get_next_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdiff_t *offset,
+                     size_t *size, int *temporal_id, int *spatial_id, OBPError *err)
+{
+    return _obp_get_next_obu(buf, buf_size, obu_type, offset, size, temporal_id, spatial_id, err);
+}
+
+int obp_index_obus(uint8_t *buf, size_t buf_size, OBPOBUIndex *index, size_t index_size,
+                   size_t *num_obus, OBPError *err)
+{
+    size_t pos = 0;
+    size_t num = 0;
+
+    *num_obus = 0;
+
+    if (buf_size > UINT32_MAX) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Packet is too large to index: %zu bytes.", buf_size);
+        return -1;
+    }
+
+    while (pos < buf_size) {
+        OBPOBUType obu_type;
+        ptrdiff_t offset;
+        size_t size;
+        int temporal_id, spatial_id;
+
+        int ret = _obp_get_next_obu(buf + pos, buf_size - pos, &obu_type, &offset, &size,
+                                    &temporal_id, &spatial_id, err);
+        if (ret < 0) {
+            err->bit_pos += pos * 8;
+            return -1;
+        }
+
+        if (num == index_size) {
+            _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, pos * 8,
+                       "Index array is too small: more than %zu OBUs in packet.", index_size);
+            return -1;
+        }
+
+        index[num].obu_type       = (uint8_t) obu_type;
+        index[num].temporal_id    = (uint8_t) temporal_id;
+        index[num].spatial_id     = (uint8_t) spatial_id;
+        index[num].header_offset  = (uint32_t) pos;
+        index[num].payload_offset = (uint32_t) (pos + (size_t) offset);
+        index[num].size           = (uint32_t) size;
+        num++;
+        *num_obus = num;
+
+        pos += (size_t) offset + size;
+    }
+
+    return 0;
+}
+
+int obp_filter_operating_point(uint8_t *buf, size_t buf_size, uint16_t operating_point_idc,
+                               OBPByteRange *ranges, size_t ranges_size, size_t *num_ranges,
+                               OBPError *err)
+{
+    size_t pos = 0;
+    size_t num = 0;
+
+    *num_ranges = 0;
+
+    if (buf_size > UINT32_MAX) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Packet is too large to filter: %zu bytes.", buf_size);
+        return -1;
+    }
+
+    while (pos < buf_size) {
+        OBPOBUType obu_type;
+        ptrdiff_t offset;
+        size_t size;
+        int temporal_id, spatial_id;
+        int obu_extension_flag = (buf[pos] & 0x04) >> 2;
+        int keep               = 1;
+
+        int ret = _obp_get_next_obu(buf + pos, buf_size - pos, &obu_type, &offset, &size,
+                                    &temporal_id, &spatial_id, err);
+        if (ret < 0) {
+            err->bit_pos += pos * 8;
+            return -1;
+        }
+
+        if (obu_type != OBP_OBU_SEQUENCE_HEADER && obu_type != OBP_OBU_TEMPORAL_DELIMITER &&
+            operating_point_idc != 0 && obu_extension_flag) {
+            int inTemporalLayer = (operating_point_idc >> temporal_id) & 1;
+            int inSpatialLayer  = (operating_point_idc >> (spatial_id + 8)) & 1;
+            keep                = inTemporalLayer && inSpatialLayer;
+        }
+
+        if (keep) {
+            if (num > 0 && ranges[num - 1].offset + ranges[num - 1].size == (uint32_t) pos) {
+                ranges[num - 1].size += (uint32_t) ((size_t) offset + size);
+            } else {
+                if (num == ranges_size) {
+                    _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, pos * 8,
+                               "Range array is too small: more than %zu ranges in packet.", ranges_size);
+                    return -1;
                 }
+                ranges[num].offset = (uint32_t) pos;
+                ranges[num].size   = (uint32_t) ((size_t) offset + size);
+                num++;
             }
+            *num_ranges = num;
         }
-    } else if (metadata->metadata_type == OBP_METADATA_TYPE_ITUT_T35) {
-        size_t offset = 1;
-        _obp_br(metadata->metadata_itut_t35.itu_t_t35_country_code, br, 8);
-        if (metadata->metadata_itut_t35.itu_t_t35_country_code == 0xFF) {
-            _obp_br(metadata->metadata_itut_t35.itu_t_t35_country_code_extension_byte, br, 8);
-            offset++;
-        }
-        metadata->metadata_itut_t35.itu_t_t35_payload_bytes = buf + consumed + offset;
-        int non_zero_bytes_seen = 0;
+
+        pos += (size_t) offset + size;
+    }
+
+    return 0;
+}
+
+int obp_find_temporal_delimiter(uint8_t *buf, size_t buf_size, int num_verify, ptrdiff_t *offset, OBPError *err)
+{
+    size_t pos = 0;
+
+    while ((pos = _obp_find_td_candidate(buf, buf_size, pos)) < buf_size) {
+        size_t obu_pos = pos + 2;
+        int valid      = 1;
+        int i;
+
         /*
-         * OBUs with byte payloads at the end have a dumb property where you need to
-         * know the trailing bits *before* you parse the OBU, despite the way the spec
-         * the syntax displayed and defined. SO as a result, you need to find the *second*
-         * non-zero byte at the end of the OBU payload, rather than the last one, as
-         * the note in the ITU T.35 part of the spec says.
+         * Chain through the OBUs that follow. Each must have its forbidden bit clear
+         * and its own size field, since an OBU without one would trivially consume the
+         * rest of the buffer. Hitting the end of the buffer exactly on an OBU boundary
+         * is accepted, but only once at least one OBU has been verified.
          */
-        for (size_t i = buf_size - consumed - offset - 1; i > 0; i--) {
-            if (metadata->metadata_itut_t35.itu_t_t35_payload_bytes[i] != 0) {
-                non_zero_bytes_seen++;
-                if (non_zero_bytes_seen == 2) {
-                    metadata->metadata_itut_t35.itu_t_t35_payload_bytes_size = i + 1;
-                }
+        for (i = 0; i < num_verify && obu_pos < buf_size; i++) {
+            OBPOBUType obu_type;
+            ptrdiff_t obu_offset;
+            size_t obu_size;
+            int temporal_id, spatial_id;
+            OBPError error = { NULL, 0, OBP_ERROR_NONE, 0, NULL }; /* Failures here are expected, and not reported. */
+
+            if ((buf[obu_pos] & 0x80) || !(buf[obu_pos] & 0x02) ||
+                _obp_get_next_obu(buf + obu_pos, buf_size - obu_pos, &obu_type, &obu_offset, &obu_size,
+                                  &temporal_id, &spatial_id, &error) < 0) {
+                valid = 0;
+                break;
             }
+
+            obu_pos += (size_t) obu_offset + obu_size;
         }
-    } else if (metadata->metadata_type == OBP_METADATA_TYPE_TIMECODE) {
-        _obp_br(metadata->metadata_timecode.counting_type, br, 5);
-        _obp_br(metadata->metadata_timecode.full_timestamp_flag, br, 1);
-        _obp_br(metadata->metadata_timecode.discontinuity_flag, br, 1);
-        _obp_br(metadata->metadata_timecode.cnt_dropped_flag, br, 1);
-        _obp_br(metadata->metadata_timecode.n_frames, br, 9);
-        if (metadata->metadata_timecode.full_timestamp_flag) {
-            _obp_br(metadata->metadata_timecode.seconds_value, br, 6);
-            _obp_br(metadata->metadata_timecode.minutes_value, br, 6);
-            _obp_br(metadata->metadata_timecode.hours_value, br, 5);
-        } else {
-            _obp_br(metadata->metadata_timecode.seconds_flag, br, 1);
-            if (metadata->metadata_timecode.seconds_flag) {
-                _obp_br(metadata->metadata_timecode.seconds_value, br, 6);
-                _obp_br(metadata->metadata_timecode.minutes_flag, br, 1);
-                if (metadata->metadata_timecode.minutes_flag) {
-                    _obp_br(metadata->metadata_timecode.minutes_value, br, 6);
-                    _obp_br(metadata->metadata_timecode.hours_flag, br, 1);
-                    if (metadata->metadata_timecode.hours_flag) {
-                        _obp_br(metadata->metadata_timecode.hours_value, br, 5);
-                    }
-                }
-            }
+
+        if (valid && i == 0 && num_verify > 0) {
+            /* Nothing follows it, and neither can any later candidate. */
+            _obp_error(err, OBP_ERROR_OUT_OF_DATA, NULL, buf_size * 8,
+                       "Temporal delimiter at offset %zu is not followed by any OBUs to verify.", pos);
+            return -1;
         }
-        _obp_br(metadata->metadata_timecode.time_offset_length, br, 5);
-        if (metadata->metadata_timecode.time_offset_length > 0) {
-             _obp_br(metadata->metadata_timecode.time_offset_value, br, metadata->metadata_timecode.time_offset_length);
+
+        if (valid) {
+            *offset = (ptrdiff_t) pos;
+            return 0;
         }
-    } else if (metadata->metadata_type >= 6 && metadata->metadata_type <= 31) {
-        metadata->unregistered.buf      = buf + consumed;
-        metadata->unregistered.buf_size = buf_size - consumed;
-    } else {
-        snprintf(err->error, err->size, "Invalid metadata type: %"PRIu32"\n", metadata->metadata_type);
+
+        pos++;
+    }
+
+    _obp_error(err, OBP_ERROR_NOT_FOUND, NULL, buf_size * 8, "No valid temporal delimiter OBU found in buffer.");
+    return -1;
+}
+
+int obp_get_next_annexb_temporal_unit(uint8_t *buf, size_t buf_size, ptrdiff_t *offset, size_t *temporal_unit_size,
+                                      OBPError *err)
+{
+    return _obp_get_annexb_unit(buf, buf_size, "temporal_unit_size", offset, temporal_unit_size, err);
+}
+
+int obp_get_next_annexb_frame_unit(uint8_t *buf, size_t buf_size, ptrdiff_t *offset, size_t *frame_unit_size,
+                                   OBPError *err)
+{
+    return _obp_get_annexb_unit(buf, buf_size, "frame_unit_size", offset, frame_unit_size, err);
+}
+
+int obp_get_next_annexb_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdiff_t *offset,
+                            size_t *obu_size, int *temporal_id, int *spatial_id, OBPError *err)
+{
+    ptrdiff_t length_size;
+    size_t obu_length;
+
+    if (_obp_get_annexb_unit(buf, buf_size, "obu_length", &length_size, &obu_length, err) < 0)
+        return -1;
+
+    if (_obp_get_next_obu(buf + length_size, obu_length, obu_type, offset, obu_size, temporal_id, spatial_id, err) < 0) {
+        err->bit_pos += (size_t) length_size * 8;
+        return -1;
+    }
+
+    /* An OBU with a size field must fill its obu_length exactly. */
+    if ((size_t) *offset + *obu_size != obu_length) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "obu_size", (size_t) (length_size + *offset) * 8,
+                   "OBU size (%zu) does not match obu_length (%zu).", (size_t) *offset + *obu_size, obu_length);
         return -1;
     }
 
+    *offset += length_size;
+
     return 0;
 }
 
-int obp_parse_frame(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq, OBPState *state,
-                    int temporal_id, int spatial_id, OBPFrameHeader *fh, OBPTileGroup *tile_group,
-                    int *SeenFrameHeader, OBPError *err)
+int obp_assembler_push(OBPAssembler *assembler, uint8_t *buf, size_t buf_size, OBPError *err)
 {
-    size_t startBitPos = 0, endBitPos, headerBytes;
-    int ret = obp_parse_frame_header(buf, buf_size, seq, state, temporal_id, spatial_id, fh, SeenFrameHeader, err);
-    if (ret < 0) {
+    if (assembler->chunk_pos < assembler->chunk_size) {
+        _obp_error(err, OBP_ERROR_INVALID_STATE, NULL, 0, "Previous chunk has not been fully consumed (%zu bytes left).",
+                   assembler->chunk_size - assembler->chunk_pos);
         return -1;
     }
-    endBitPos   = state->frame_header_end_pos;
-    headerBytes = (endBitPos - startBitPos) / 8;
-    return obp_parse_tile_group(buf + headerBytes, buf_size - headerBytes, fh, tile_group, SeenFrameHeader, err);
+
+    assembler->chunk      = buf;
+    assembler->chunk_size = buf_size;
+    assembler->chunk_pos  = 0;
+
+    return 0;
 }
 
-int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq, OBPState *state,
-                           int temporal_id, int spatial_id, OBPFrameHeader *fh, int *SeenFrameHeader, OBPError *err)
+int obp_assembler_get_next_obu(OBPAssembler *assembler, OBPAssembledOBU *obu, OBPError *err)
 {
-    _OBPBitReader b   = _obp_new_br(buf, buf_size);
-    _OBPBitReader *br = &b;
+    uint8_t *chunk;
+    size_t left;
+    size_t total = 0;
+    int ret;
 
-    if (*SeenFrameHeader == 1) {
-        if (!state->prev_filled) {
-            snprintf(err->error, err->size, "SeenFrameHeader is one, but no previous header exists in state.");
+    if (assembler->chunk == NULL)
+        return 0;
+
+    chunk = assembler->chunk + assembler->chunk_pos;
+    left  = assembler->chunk_size - assembler->chunk_pos;
+
+    if (assembler->scratch_fill == 0) {
+        if (left == 0)
+            return 0;
+
+        ret = _obp_get_obu_total_size(chunk, left, &total, err);
+        if (ret < 0)
             return -1;
+
+        if (ret == 1 && total <= left) {
+            /* The common case: the whole OBU is in this chunk, so no copy is needed. */
+            assembler->chunk_pos += total;
+            return _obp_assembler_emit(chunk, total, obu, err);
         }
-        *fh = state->prev;
+
+        if ((ret == 1 && total > assembler->scratch_size) || left > assembler->scratch_size) {
+            _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "OBU straddling chunks is larger than scratch buffer (%zu).",
+                       assembler->scratch_size);
+            return -1;
+        }
+
+        memcpy(assembler->scratch, chunk, left);
+        assembler->scratch_fill = left;
+        assembler->chunk_pos    = assembler->chunk_size;
+
         return 0;
     }
 
-    *SeenFrameHeader = 1;
+    /*
+     * Continue a straddling OBU. Until its header and size are complete, bytes are
+     * copied a few at a time, since the size is needed to know how much to copy.
+     */
+    while (1) {
+        size_t copy;
 
-    /* uncompressed_header() */
-    int idLen = 0; /* only set to 0 to shut up a compiler warning. */
-    if (seq->frame_id_numbers_present_flag) {
-        idLen = seq->additional_frame_id_length_minus_1 + seq->delta_frame_id_length_minus_2 + 3;
-    }
-    uint8_t allFrames = 255; /* (1 << 8) - 1 */
-    int FrameIsIntra;
-    if (seq->reduced_still_picture_header) {
-        fh->show_existing_frame = 0;
-        fh->frame_type          = OBP_KEY_FRAME;
-        FrameIsIntra            = 1;
-        fh->show_frame          = 1;
-        fh->showable_frame      = 1;
-    } else {
-        _obp_br(fh->show_existing_frame, br, 1);
+        ret = _obp_get_obu_total_size(assembler->scratch, assembler->scratch_fill, &total, err);
+        if (ret < 0)
+            return -1;
+
+        if (ret == 1 && total > assembler->scratch_size) {
+            _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "OBU straddling chunks is larger than scratch buffer (%zu).",
+                       assembler->scratch_size);
+            return -1;
+        }
+
+        if (ret == 1 && assembler->scratch_fill >= total)
+            break;
+
+        if (left == 0)
+            return 0;
+
+        copy = (ret == 1) ? total - assembler->scratch_fill : 1;
+        copy = _OBP_MIN(copy, left);
+        if (copy > assembler->scratch_size - assembler->scratch_fill) {
+            _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "OBU straddling chunks is larger than scratch buffer (%zu).",
+                       assembler->scratch_size);
+            return -1;
+        }
+
+        memcpy(assembler->scratch + assembler->scratch_fill, chunk, copy);
+        assembler->scratch_fill += copy;
+        assembler->chunk_pos    += copy;
+        chunk                   += copy;
+        left                    -= copy;
+    }
+
+    assembler->scratch_fill = 0;
+
+    return _obp_assembler_emit(assembler->scratch, total, obu, err);
+}
+
+int obp_parse_ivf_header(uint8_t *buf, size_t buf_size, OBPIVFHeader *ivf_header, OBPError *err)
+{
+    if (buf_size < 32) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, NULL, buf_size * 8, "Buffer too small to contain IVF header: %zu bytes.", buf_size);
+        return -1;
+    }
+
+    if (memcmp(buf, "DKIF", 4) != 0) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "signature", 0, "Invalid IVF signature.");
+        return -1;
+    }
+
+    ivf_header->version     = (uint16_t) _obp_le(buf + 4, 2);
+    ivf_header->header_size = (uint16_t) _obp_le(buf + 6, 2);
+    memcpy(&ivf_header->fourcc[0], buf + 8, 4);
+    ivf_header->width        = (uint16_t) _obp_le(buf + 12, 2);
+    ivf_header->height       = (uint16_t) _obp_le(buf + 14, 2);
+    ivf_header->timebase_den = (uint32_t) _obp_le(buf + 16, 4);
+    ivf_header->timebase_num = (uint32_t) _obp_le(buf + 20, 4);
+    ivf_header->num_frames   = (uint32_t) _obp_le(buf + 24, 4);
+
+    if (ivf_header->version != 0) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "version", 4 * 8, "Unsupported IVF version: %"PRIu16".",
+                   ivf_header->version);
+        return -1;
+    }
+
+    if (ivf_header->header_size < 32) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "header_size", 6 * 8, "Invalid IVF header size: %"PRIu16".",
+                   ivf_header->header_size);
+        return -1;
+    }
+
+    if (memcmp(&ivf_header->fourcc[0], "AV01", 4) != 0) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "fourcc", 8 * 8, "Unsupported IVF FourCC: 0x%08"PRIX32".",
+                   (uint32_t) _obp_le(buf + 8, 4));
+        return -1;
+    }
+
+    return 0;
+}
+
+int obp_get_next_ivf_frame(uint8_t *buf, size_t buf_size, ptrdiff_t *offset, size_t *frame_size,
+                           int64_t *pts, OBPError *err)
+{
+    if (buf_size < 12) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, NULL, buf_size * 8, "Buffer too small to contain IVF frame header: %zu bytes.",
+                   buf_size);
+        return -1;
+    }
+
+    *frame_size = (size_t) _obp_le(buf, 4);
+    *pts        = (int64_t) _obp_le(buf + 4, 8);
+    *offset     = 12;
+
+    if (*frame_size > buf_size - 12) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, "frame_size", 0, "IVF frame truncated: %zu bytes needed, %zu available.",
+                   *frame_size, buf_size - 12);
+        return -1;
+    }
+
+    return 0;
+}
+
+int obp_get_next_mp4_box(uint8_t *buf, size_t buf_size, uint8_t box_type[4], ptrdiff_t *offset,
+                         size_t *payload_size, OBPError *err)
+{
+    uint64_t size;
+
+    if (buf_size < 8) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, NULL, buf_size * 8, "Buffer too small to contain box header: %zu bytes.",
+                   buf_size);
+        return -1;
+    }
+
+    size = _obp_be(buf, 4);
+    memcpy(&box_type[0], buf + 4, 4);
+    *offset = 8;
+
+    if (size == 1) {
+        if (buf_size < 16) {
+            _obp_error(err, OBP_ERROR_OUT_OF_DATA, "largesize", buf_size * 8,
+                       "Buffer too small to contain box header: %zu bytes.", buf_size);
+            return -1;
+        }
+        size    = _obp_be(buf + 8, 8);
+        *offset = 16;
+    } else if (size == 0) {
+        size = (uint64_t) buf_size;
+    }
+
+    if (size < (uint64_t) *offset) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "size", 0, "Invalid box size: %"PRIu64".", size);
+        return -1;
+    }
+
+    if (size > (uint64_t) buf_size) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, "size", 0, "Box truncated: %"PRIu64" bytes needed, %zu available.",
+                   size, buf_size);
+        return -1;
+    }
+
+    *payload_size = (size_t) size - (size_t) *offset;
+
+    return 0;
+}
+
+int obp_parse_av1c(uint8_t *buf, size_t buf_size, OBPAV1CodecConfig *config, OBPSequenceHeader *seq_header,
+                   int *seq_header_present, OBPError *err)
+{
+    size_t pos;
+
+    if (buf_size < 4) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, NULL, buf_size * 8,
+                   "Buffer too small to contain AV1 codec configuration record: %zu bytes.", buf_size);
+        return -1;
+    }
+
+    if (!(buf[0] & 0x80)) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "marker", 0, "Invalid av1C marker bit.");
+        return -1;
+    }
+
+    config->version = buf[0] & 0x7F;
+    if (config->version != 1) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "version", 1, "Unsupported av1C version: %"PRIu8".", config->version);
+        return -1;
+    }
+
+    config->seq_profile                          = (buf[1] & 0xE0) >> 5;
+    config->seq_level_idx_0                      = buf[1] & 0x1F;
+    config->seq_tier_0                           = (buf[2] & 0x80) >> 7;
+    config->high_bitdepth                        = (buf[2] & 0x40) >> 6;
+    config->twelve_bit                           = (buf[2] & 0x20) >> 5;
+    config->monochrome                           = (buf[2] & 0x10) >> 4;
+    config->chroma_subsampling_x                 = (buf[2] & 0x08) >> 3;
+    config->chroma_subsampling_y                 = (buf[2] & 0x04) >> 2;
+    config->chroma_sample_position               = (OBPChromaSamplePosition) (buf[2] & 0x03);
+    config->initial_presentation_delay_present   = (buf[3] & 0x10) >> 4;
+    config->initial_presentation_delay_minus_one = config->initial_presentation_delay_present ? (buf[3] & 0x0F) : 0;
+    config->config_obus_offset                   = 4;
+    config->config_obus_size                     = buf_size - 4;
+
+    if (seq_header == NULL)
+        return 0;
+
+    *seq_header_present = 0;
+
+    pos = config->config_obus_offset;
+    while (pos < buf_size) {
+        OBPOBUType obu_type;
+        ptrdiff_t offset;
+        size_t obu_size;
+        int temporal_id, spatial_id;
+
+        int ret = _obp_get_next_obu(buf + pos, buf_size - pos, &obu_type, &offset, &obu_size,
+                                    &temporal_id, &spatial_id, err);
+        if (ret < 0) {
+            err->bit_pos += pos * 8;
+            _obp_error_prefix(err, "Failed to parse configOBUs: ");
+            return -1;
+        }
+
+        if (obu_type == OBP_OBU_SEQUENCE_HEADER) {
+            /* obp_parse_sequence_header leaves fields which are not present untouched. */
+            memset(seq_header, 0, sizeof(*seq_header));
+            ret = obp_parse_sequence_header(buf + pos + (size_t) offset, obu_size, seq_header, err);
+            if (ret < 0) {
+                err->bit_pos += (pos + (size_t) offset) * 8;
+                _obp_error_prefix(err, "Failed to parse configOBUs: ");
+                return -1;
+            }
+            *seq_header_present = 1;
+            break;
+        }
+
+        pos += (size_t) offset + obu_size;
+    }
+
+    return 0;
+}
+
+int obp_write_av1c(OBPSequenceHeader *seq_header, uint8_t *seq_header_obu, size_t seq_header_obu_size,
+                   uint8_t *buf, size_t buf_size, size_t *size, OBPError *err)
+{
+    ptrdiff_t offset;
+    size_t payload_size;
+    size_t pos = 0;
+
+    if (_obp_get_av1c_size(seq_header_obu, seq_header_obu_size, &offset, &payload_size, size, err) < 0)
+        return -1;
+
+    if (buf_size < *size) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Output buffer is too small: %zu bytes, %zu needed.",
+                   buf_size, *size);
+        return -1;
+    }
+
+    _obp_put_av1c(seq_header, seq_header_obu, offset, payload_size, buf, &pos);
+
+    return 0;
+}
+
+int obp_write_av01_sample_entry(OBPSequenceHeader *seq_header, uint8_t *seq_header_obu, size_t seq_header_obu_size,
+                                uint8_t *buf, size_t buf_size, size_t *size, OBPError *err)
+{
+    uint32_t width  = seq_header->max_frame_width_minus_1 + 1;
+    uint32_t height = seq_header->max_frame_height_minus_1 + 1;
+    int has_colr    = seq_header->color_config.color_description_present_flag;
+    ptrdiff_t offset;
+    size_t payload_size, av1c_size;
+    size_t pos = 0;
+
+    if (width > UINT16_MAX || height > UINT16_MAX) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0,
+                   "Frame size is too large for a sample entry: %"PRIu32"x%"PRIu32".", width, height);
+        return -1;
+    }
+
+    if (_obp_get_av1c_size(seq_header_obu, seq_header_obu_size, &offset, &payload_size, &av1c_size, err) < 0)
+        return -1;
+
+    *size = 8 + _OBP_VISUAL_SAMPLE_ENTRY_SIZE + 8 + av1c_size + (has_colr ? _OBP_COLR_BOX_SIZE : 0);
+
+    if (buf_size < *size) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Output buffer is too small: %zu bytes, %zu needed.",
+                   buf_size, *size);
+        return -1;
+    }
+
+    _obp_put_be(buf, &pos, *size, 4);
+    memcpy(buf + pos, "av01", 4);
+    pos += 4;
+
+    /* SampleEntry and VisualSampleEntry fields. */
+    memset(buf + pos, 0, _OBP_VISUAL_SAMPLE_ENTRY_SIZE);
+    pos += 6;
+    _obp_put_be(buf, &pos, 1, 2);          /* data_reference_index */
+    pos += 16;
+    _obp_put_be(buf, &pos, width, 2);
+    _obp_put_be(buf, &pos, height, 2);
+    _obp_put_be(buf, &pos, 0x00480000, 4); /* horizresolution, 72 dpi */
+    _obp_put_be(buf, &pos, 0x00480000, 4); /* vertresolution, 72 dpi */
+    pos += 4;
+    _obp_put_be(buf, &pos, 1, 2);          /* frame_count */
+    memcpy(buf + pos, "\012AOM Coding", 11); /* compressorname, as recommended by the AV1 ISOBMFF binding. */
+    pos += 32;
+    _obp_put_be(buf, &pos, 0x0018, 2);     /* depth */
+    _obp_put_be(buf, &pos, 0xFFFF, 2);     /* pre_defined = -1 */
+
+    _obp_put_be(buf, &pos, 8 + av1c_size, 4);
+    memcpy(buf + pos, "av1C", 4);
+    pos += 4;
+    _obp_put_av1c(seq_header, seq_header_obu, offset, payload_size, buf, &pos);
+
+    if (has_colr) {
+        _obp_put_be(buf, &pos, _OBP_COLR_BOX_SIZE, 4);
+        memcpy(buf + pos, "colrnclx", 8);
+        pos += 8;
+        _obp_put_be(buf, &pos, seq_header->color_config.color_primaries, 2);
+        _obp_put_be(buf, &pos, seq_header->color_config.transfer_characteristics, 2);
+        _obp_put_be(buf, &pos, seq_header->color_config.matrix_coefficients, 2);
+        _obp_put_be(buf, &pos, seq_header->color_config.color_range ? 0x80 : 0, 1);
+    }
+
+    assert(pos == *size);
+
+    return 0;
+}
+
+int obp_parse_sequence_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq_header, OBPError *err)
+{
+    _OBPBitReader b   = _obp_new_br(buf, buf_size);
+    _OBPBitReader *br = &b;
+    int ret;
+
+    _obp_br(seq_header->seq_profile, br, 3);
+    _obp_br(seq_header->still_picture, br, 1);
+    _obp_br(seq_header->reduced_still_picture_header, br, 1);
+    if (seq_header->reduced_still_picture_header) {
+        seq_header->timing_info_present_flag                     = 0;
+        seq_header->decoder_model_info_present_flag              = 0;
+        seq_header->initial_display_delay_present_flag           = 0;
+        seq_header->operating_points_cnt_minus_1                 = 0;
+        seq_header->operating_point_idc[0]                       = 0;
+        _obp_br(seq_header->seq_level_idx[0], br, 5);
+        seq_header->seq_tier[0]                                  = 0;
+        seq_header->decoder_model_present_for_this_op[0]         = 0;
+        seq_header->initial_display_delay_present_for_this_op[0] = 0;
+    } else {
+        _obp_br(seq_header->timing_info_present_flag, br, 1);
+        if (seq_header->timing_info_present_flag) {
+            /* timing_info() */
+            _obp_br(seq_header->timing_info.num_units_in_display_tick, br, 32);
+            _obp_br(seq_header->timing_info.time_scale, br, 32);
+            _obp_br(seq_header->timing_info.equal_picture_interval, br, 1);
+            if (seq_header->timing_info.equal_picture_interval) {
+                ret = _obp_uvlc(br, &seq_header->timing_info.num_ticks_per_picture_minus_1, err);
+                if (ret < 0)
+                    return -1;
+            }
+            _obp_br(seq_header->decoder_model_info_present_flag, br, 1);
+            if (seq_header->decoder_model_info_present_flag) {
+                /* decoder_model_info() */
+                _obp_br(seq_header->decoder_model_info.buffer_delay_length_minus_1, br, 5);
+                _obp_br(seq_header->decoder_model_info.num_units_in_decoding_tick, br, 32);
+                _obp_br(seq_header->decoder_model_info.buffer_removal_time_length_minus_1, br, 5);
+                _obp_br(seq_header->decoder_model_info.frame_presentation_time_length_minus_1, br, 5);
+            }
+        } else {
+            seq_header->decoder_model_info_present_flag = 0;
+        }
+        _obp_br(seq_header->initial_display_delay_present_flag, br, 1);
+        _obp_br(seq_header->operating_points_cnt_minus_1, br, 5);
+        for (uint8_t i = 0; i <= seq_header->operating_points_cnt_minus_1; i++) {
+            if (_obp_br_bits_left(br) >= _OBP_OPERATING_POINT_MAX_BITS) {
+                ret = _obp_read_operating_point(br, seq_header, i, 0, err);
+            } else {
+                ret = _obp_read_operating_point(br, seq_header, i, 1, err);
+            }
+            if (ret < 0)
+                return -1;
+        }
+    }
+    _obp_br(seq_header->frame_width_bits_minus_1, br, 4);
+    _obp_br(seq_header->frame_height_bits_minus_1, br, 4);
+    _obp_br(seq_header->max_frame_width_minus_1, br, seq_header->frame_width_bits_minus_1 + 1);
+    _obp_br(seq_header->max_frame_height_minus_1, br, seq_header->frame_height_bits_minus_1 + 1);
+    if (seq_header->reduced_still_picture_header) {
+        seq_header->frame_id_numbers_present_flag = 0;
+    } else {
+        _obp_br(seq_header->frame_id_numbers_present_flag, br, 1);
+    }
+    if (seq_header->frame_id_numbers_present_flag) {
+        _obp_br(seq_header->delta_frame_id_length_minus_2, br, 4);
+        _obp_br(seq_header->additional_frame_id_length_minus_1, br, 3);
+    }
+    if (_obp_br_bits_left(br) >= _OBP_SEQUENCE_TOOLS_MAX_BITS) {
+        ret = _obp_read_sequence_tools(br, seq_header, 0, err);
+    } else {
+        ret = _obp_read_sequence_tools(br, seq_header, 1, err);
+    }
+    if (ret < 0)
+        return -1;
+    /* color_config() */
+    _obp_br(seq_header->color_config.high_bitdepth, br, 1);
+    if (seq_header->seq_profile == 2 && seq_header->color_config.high_bitdepth) {
+        _obp_br(seq_header->color_config.twelve_bit, br, 1);
+        seq_header->color_config.BitDepth = seq_header->color_config.twelve_bit ? 12 : 10;
+    } else {
+        seq_header->color_config.BitDepth = seq_header->color_config.high_bitdepth ? 10 : 8;
+    }
+    if (seq_header->seq_profile == 1) {
+        seq_header->color_config.mono_chrome = 0;
+    } else {
+        _obp_br(seq_header->color_config.mono_chrome, br, 1);
+    }
+    seq_header->color_config.NumPlanes = seq_header->color_config.mono_chrome ? 1 : 3;
+    _obp_br(seq_header->color_config.color_description_present_flag, br, 1);
+    if (seq_header->color_config.color_description_present_flag) {
+        _obp_br(seq_header->color_config.color_primaries, br, 8);
+        _obp_br(seq_header->color_config.transfer_characteristics, br, 8);
+        _obp_br(seq_header->color_config.matrix_coefficients, br, 8);
+    } else {
+        seq_header->color_config.color_primaries          = OBP_CP_UNSPECIFIED;
+        seq_header->color_config.transfer_characteristics = OBP_TC_UNSPECIFIED;
+        seq_header->color_config.matrix_coefficients      = OBP_MC_UNSPECIFIED;
+    }
+    if (seq_header->color_config.mono_chrome) {
+        _obp_br(seq_header->color_config.color_range, br, 1);
+        seq_header->color_config.subsampling_x          = 1;
+        seq_header->color_config.subsampling_y          = 1;
+        seq_header->color_config.chroma_sample_position = OBP_CSP_UNKNOWN;
+        seq_header->color_config.separate_uv_delta_q    = 0;
+        goto color_done;
+    } else if (seq_header->color_config.color_primaries == OBP_CP_BT_709 &&
+               seq_header->color_config.transfer_characteristics == OBP_TC_SRGB &&
+               seq_header->color_config.matrix_coefficients == OBP_MC_IDENTITY) {
+        seq_header->color_config.color_range = 1;
+        seq_header->color_config.subsampling_x = 0;
+        seq_header->color_config.subsampling_y = 0;
+    } else {
+        _obp_br(seq_header->color_config.color_range, br, 1);
+        if (seq_header->seq_profile == 0) {
+            seq_header->color_config.subsampling_x = 1;
+            seq_header->color_config.subsampling_y = 1;
+        } else if (seq_header->seq_profile == 1) {
+            seq_header->color_config.subsampling_x = 0;
+            seq_header->color_config.subsampling_y = 0;
+        } else {
+            if (seq_header->color_config.BitDepth == 12) {
+                _obp_br(seq_header->color_config.subsampling_x, br, 1);
+                if (seq_header->color_config.subsampling_x) {
+                    _obp_br(seq_header->color_config.subsampling_y, br, 1);
+                } else {
+                    seq_header->color_config.subsampling_y = 0;
+                }
+            } else {
+                seq_header->color_config.subsampling_x = 1;
+                seq_header->color_config.subsampling_y = 0;
+            }
+        }
+        if (seq_header->color_config.subsampling_x && seq_header->color_config.subsampling_y) {
+            _obp_br(seq_header->color_config.chroma_sample_position, br, 2);
+        }
+    }
+    _obp_br(seq_header->color_config.separate_uv_delta_q, br, 1);
+
+color_done:
+    _obp_br(seq_header->film_grain_params_present, br, 1);
+
+    /* Derived values used by every frame header. */
+    if (seq_header->frame_id_numbers_present_flag) {
+        seq_header->idLen = seq_header->additional_frame_id_length_minus_1 + seq_header->delta_frame_id_length_minus_2 + 3;
+    } else {
+        seq_header->idLen = 0;
+    }
+    if (seq_header->enable_order_hint && seq_header->OrderHintBits) {
+        seq_header->OrderHintSignBit = ((uint32_t) 1) << (seq_header->OrderHintBits - 1);
+        seq_header->OrderHintLowMask = seq_header->OrderHintSignBit - 1;
+    } else {
+        seq_header->OrderHintSignBit = 0;
+        seq_header->OrderHintLowMask = 0;
+    }
+    seq_header->sbShift           = seq_header->use_128x128_superblock ? 5 : 4;
+    seq_header->OperatingPoint    = 0;
+    seq_header->OperatingPointIdc = seq_header->operating_point_idc[seq_header->OperatingPoint];
+
+    return 0;
+}
+
+int obp_parse_sequence_header_cached(uint8_t *buf, size_t buf_size, OBPSequenceHeaderCache *cache,
+                                     OBPSequenceHeader **seq_header, int *changed, OBPError *err)
+{
+    OBPSequenceHeaderCacheEntry *entry  = NULL;
+    OBPSequenceHeaderCacheEntry *victim = NULL;
+    int cacheable                       = (buf_size <= OBP_SEQUENCE_HEADER_CACHE_MAX_OBU_SIZE);
+    uint64_t hash                       = cacheable ? _obp_fnv1a(buf, buf_size) : 0;
+
+    for (int i = 0; i < OBP_SEQUENCE_HEADER_CACHE_ENTRIES; i++) {
+        OBPSequenceHeaderCacheEntry *e = &cache->entries[i];
+        if (cacheable && e->valid && e->cached && e->hash == hash && e->size == buf_size &&
+            !memcmp(e->data, buf, buf_size)) {
+            entry = e;
+            break;
+        }
+        /* Never evict the current entry, since it is needed to detect changes. */
+        if (e != cache->current && (victim == NULL || !e->valid || (victim->valid && e->last_use < victim->last_use)))
+            victim = e;
+    }
+
+    if (entry == NULL) {
+        int ret;
+
+        entry        = victim;
+        entry->valid = 0;
+        memset(&entry->seq_header, 0, sizeof(entry->seq_header));
+        ret = obp_parse_sequence_header(buf, buf_size, &entry->seq_header, err);
+        if (ret < 0)
+            return -1;
+
+        entry->valid           = 1;
+        entry->cached          = cacheable;
+        entry->hash            = hash;
+        entry->size            = buf_size;
+        entry->codec_string[0] = '\0';
+        if (cacheable)
+            memcpy(entry->data, buf, buf_size);
+    }
+
+    if (entry == cache->current)
+        *changed = 0;
+    else
+        *changed = (cache->current == NULL ||
+                    memcmp(&entry->seq_header, &cache->current->seq_header, sizeof(entry->seq_header)) != 0);
+
+    entry->last_use = ++cache->use_count;
+    cache->current  = entry;
+    *seq_header     = &entry->seq_header;
+
+    return 0;
+}
+
+int obp_get_codec_string(OBPSequenceHeader *seq_header, char *buf, size_t buf_size, OBPError *err)
+{
+    int ret;
+    int has_csp = !seq_header->color_config.mono_chrome && seq_header->color_config.subsampling_x &&
+                  seq_header->color_config.subsampling_y;
+
+    ret = snprintf(buf, buf_size, "av01.%u.%02u%c.%02u.%d.%d%d%u.%02u.%02u.%02u.%d",
+                   (unsigned int) seq_header->seq_profile, (unsigned int) seq_header->seq_level_idx[0],
+                   seq_header->seq_tier[0] ? 'H' : 'M', (unsigned int) seq_header->color_config.BitDepth,
+                   !!seq_header->color_config.mono_chrome, !!seq_header->color_config.subsampling_x,
+                   !!seq_header->color_config.subsampling_y,
+                   has_csp ? (unsigned int) seq_header->color_config.chroma_sample_position : 0,
+                   (unsigned int) seq_header->color_config.color_primaries,
+                   (unsigned int) seq_header->color_config.transfer_characteristics,
+                   (unsigned int) seq_header->color_config.matrix_coefficients,
+                   !!seq_header->color_config.color_range);
+    assert(ret > 0 && ret < OBP_CODEC_STRING_MAX_SIZE);
+
+    if ((size_t) ret >= buf_size) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Output buffer is too small: %zu bytes, %d needed.",
+                   buf_size, ret + 1);
+        return -1;
+    }
+
+    return 0;
+}
+
+int obp_get_codec_string_cached(OBPSequenceHeaderCache *cache, const char **codec_string, OBPError *err)
+{
+    OBPSequenceHeaderCacheEntry *entry = cache->current;
+
+    if (entry == NULL || !entry->valid) {
+        _obp_error(err, OBP_ERROR_INVALID_STATE, NULL, 0, "No sequence header has been parsed into the cache.");
+        return -1;
+    }
+
+    if (entry->codec_string[0] == '\0') {
+        int ret = obp_get_codec_string(&entry->seq_header, &entry->codec_string[0], sizeof(entry->codec_string), err);
+        if (ret < 0)
+            return -1;
+    }
+
+    *codec_string = &entry->codec_string[0];
+
+    return 0;
+}
+
+int obp_parse_tile_list(uint8_t *buf, size_t buf_size, OBPTileList *tile_list, OBPError *err)
+{
+    if (buf_size < 4) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, "tile_count_minus_1", 0, "Tile list OBU must be at least 4 bytes.");
+        return -1;
+    }
+
+    tile_list->output_frame_width_in_tiles_minus_1  = buf[0];
+    tile_list->output_frame_height_in_tiles_minus_1 = buf[1];
+    tile_list->tile_count_minus_1                   = (((uint16_t) buf[2]) << 8) | buf[3];
+    tile_list->next_entry_pos                       = 4;
+    tile_list->next_entry                           = 0;
+
+    if (tile_list->tile_list_entry == NULL)
+        return 0;
+
+    if (((size_t) tile_list->tile_count_minus_1) + 1 > tile_list->tile_list_entry_capacity) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 32,
+                   "Tile list entry array is too small: %zu entries for %"PRIu32" tiles.",
+                   tile_list->tile_list_entry_capacity, ((uint32_t) tile_list->tile_count_minus_1) + 1);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i <= tile_list->tile_count_minus_1; i++) {
+        int ret = obp_get_next_tile_list_entry(buf, buf_size, tile_list, &tile_list->tile_list_entry[i], err);
+        if (ret < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+int obp_get_next_tile_list_entry(uint8_t *buf, size_t buf_size, OBPTileList *tile_list, OBPTileListEntry *entry,
+                                 OBPError *err)
+{
+    size_t pos = tile_list->next_entry_pos;
+    size_t N;
+
+    if (tile_list->next_entry > tile_list->tile_count_minus_1) {
+        _obp_error(err, OBP_ERROR_INVALID_STATE, NULL, pos * 8, "All tile list entries have already been read.");
+        return -1;
+    }
+
+    if (pos > buf_size || buf_size - pos < 5) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, "tile_list_entry()", pos * 8,
+                   "Tile list OBU malformed: Not enough bytes for next tile_list_entry().");
+        return -1;
+    }
+
+    entry->anchor_frame_idx       = buf[pos];
+    entry->anchor_tile_row        = buf[pos + 1];
+    entry->anchor_tile_col        = buf[pos + 2];
+    entry->tile_data_size_minus_1 = (((uint16_t) buf[pos + 3]) << 8) | buf[pos + 4];
+    pos += 5;
+
+    /* coded_tile_data is f(N), with N = 8 * (tile_data_size_minus_1 + 1) bits. */
+    N = ((size_t) entry->tile_data_size_minus_1) + 1;
+
+    if (N > buf_size - pos) {
+        _obp_error(err, OBP_ERROR_OUT_OF_DATA, "coded_tile_data", pos * 8,
+                   "Tile list OBU malformed: Not enough bytes for next tile_list_entry()'s data.");
+        return -1;
+    }
+
+    entry->coded_tile_data      = buf + pos;
+    entry->coded_tile_data_size = N;
+    pos += N;
+
+    tile_list->next_entry_pos = pos;
+    tile_list->next_entry++;
+
+    return 0;
+}
+
+int obp_parse_tile_group(uint8_t *buf, size_t buf_size, OBPFrameHeader *frame_header, OBPTileGroup *tile_group,
+                         int *SeenFrameHeader, OBPError *err)
+{
+    return _obp_parse_tile_group(buf, buf_size, 0, frame_header, tile_group, 0, SeenFrameHeader, err);
+}
+
+int obp_parse_metadata(uint8_t *buf, size_t buf_size, OBPMetadata *metadata, OBPError *err)
+{
+    uint64_t val;
+    ptrdiff_t consumed;
+    _OBPBitReader b;
+    _OBPBitReader *br;
+
+    int ret = _obp_leb128(buf, buf_size, &val, &consumed, err);
+    if (ret < 0) {
+        err->element = "metadata_type";
+        _obp_error_prefix(err, "Couldn't read metadata type: ");
+        return -1;
+    }
+    metadata->metadata_type = val;
+
+    /* Start the bitreader past metadata_type, so that error positions are relative to buf. */
+    b         = _obp_new_br(buf, buf_size);
+    b.buf_pos = (size_t) consumed;
+    br        = &b;
+
+    if (metadata->metadata_type == OBP_METADATA_TYPE_HDR_CLL) {
+        _obp_br(metadata->metadata_hdr_cll.max_cll, br, 16);
+        _obp_br(metadata->metadata_hdr_cll.max_fall, br, 16);
+    } else if (metadata->metadata_type == OBP_METADATA_TYPE_HDR_MDCV) {
+        for (int i = 0; i < 3; i++) {
+            _obp_br(metadata->metadata_hdr_mdcv.primary_chromaticity_x[i], br, 16);
+            _obp_br(metadata->metadata_hdr_mdcv.primary_chromaticity_y[i], br, 16);
+        }
+        _obp_br(metadata->metadata_hdr_mdcv.white_point_chromaticity_x, br, 16);
+        _obp_br(metadata->metadata_hdr_mdcv.white_point_chromaticity_y, br, 16);
+        _obp_br(metadata->metadata_hdr_mdcv.luminance_max, br, 32);
+        _obp_br(metadata->metadata_hdr_mdcv.luminance_min, br, 32);
+    } else if (metadata->metadata_type == OBP_METADATA_TYPE_SCALABILITY) {
+        _obp_br(metadata->metadata_scalability.scalability_mode_idc, br, 8);
+        if (metadata->metadata_scalability.scalability_mode_idc) {
+            /* scalability_structure() */
+            _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layers_cnt_minus_1, br, 2);
+            _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_dimensions_present_flag, br, 1);
+            _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_description_present_flag, br, 1);
+            _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_description_present_flag, br, 1);
+            _obp_br(metadata->metadata_scalability.scalability_structure.scalability_structure_reserved_3bits, br, 3);
+            if (metadata->metadata_scalability.scalability_structure.spatial_layer_dimensions_present_flag) {
+                for (uint8_t i = 0; i <= metadata->metadata_scalability.scalability_structure.spatial_layers_cnt_minus_1; i++) {
+                    _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_max_width[i], br, 16);
+                    _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_max_height[i], br, 16);
+                }
+            }
+            if (metadata->metadata_scalability.scalability_structure.spatial_layer_description_present_flag) {
+                for (uint8_t i = 0; i <= metadata->metadata_scalability.scalability_structure.spatial_layers_cnt_minus_1; i++) {
+                    _obp_br(metadata->metadata_scalability.scalability_structure.spatial_layer_ref_id[i], br, 8);
+                }
+            }
+            if (metadata->metadata_scalability.scalability_structure.temporal_group_description_present_flag) {
+                _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_size, br, 8);
+                for (uint8_t i = 0; i < metadata->metadata_scalability.scalability_structure.temporal_group_size; i++) {
+                    _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_temporal_id[i], br, 3);
+                    _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_temporal_switching_up_point_flag[i], br, 1);
+                    _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_spatial_switching_up_point_flag[i], br, 1);
+                    _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_ref_cnt[i], br, 3);
+                    for (uint8_t j = 0; j < metadata->metadata_scalability.scalability_structure.temporal_group_ref_cnt[i]; j++) {
+                        _obp_br(metadata->metadata_scalability.scalability_structure.temporal_group_ref_pic_diff[i][j], br, 8);
+                    }
+                }
+            }
+        }
+    } else if (metadata->metadata_type == OBP_METADATA_TYPE_ITUT_T35) {
+        size_t offset = 1;
+        _obp_br(metadata->metadata_itut_t35.itu_t_t35_country_code, br, 8);
+        if (metadata->metadata_itut_t35.itu_t_t35_country_code == 0xFF) {
+            _obp_br(metadata->metadata_itut_t35.itu_t_t35_country_code_extension_byte, br, 8);
+            offset++;
+        }
+        metadata->metadata_itut_t35.itu_t_t35_payload_bytes = buf + consumed + offset;
+        int non_zero_bytes_seen = 0;
+        /*
+         * OBUs with byte payloads at the end have a dumb property where you need to
+         * know the trailing bits *before* you parse the OBU, despite the way the spec
+         * the syntax displayed and defined. SO as a result, you need to find the *second*
+         * non-zero byte at the end of the OBU payload, rather than the last one, as
+         * the note in the ITU T.35 part of the spec says.
+         */
+        for (size_t i = buf_size - consumed - offset - 1; i > 0; i--) {
+            if (metadata->metadata_itut_t35.itu_t_t35_payload_bytes[i] != 0) {
+                non_zero_bytes_seen++;
+                if (non_zero_bytes_seen == 2) {
+                    metadata->metadata_itut_t35.itu_t_t35_payload_bytes_size = i + 1;
+                }
+            }
+        }
+    } else if (metadata->metadata_type == OBP_METADATA_TYPE_TIMECODE) {
+        _obp_br(metadata->metadata_timecode.counting_type, br, 5);
+        _obp_br(metadata->metadata_timecode.full_timestamp_flag, br, 1);
+        _obp_br(metadata->metadata_timecode.discontinuity_flag, br, 1);
+        _obp_br(metadata->metadata_timecode.cnt_dropped_flag, br, 1);
+        _obp_br(metadata->metadata_timecode.n_frames, br, 9);
+        if (metadata->metadata_timecode.full_timestamp_flag) {
+            _obp_br(metadata->metadata_timecode.seconds_value, br, 6);
+            _obp_br(metadata->metadata_timecode.minutes_value, br, 6);
+            _obp_br(metadata->metadata_timecode.hours_value, br, 5);
+        } else {
+            _obp_br(metadata->metadata_timecode.seconds_flag, br, 1);
+            if (metadata->metadata_timecode.seconds_flag) {
+                _obp_br(metadata->metadata_timecode.seconds_value, br, 6);
+                _obp_br(metadata->metadata_timecode.minutes_flag, br, 1);
+                if (metadata->metadata_timecode.minutes_flag) {
+                    _obp_br(metadata->metadata_timecode.minutes_value, br, 6);
+                    _obp_br(metadata->metadata_timecode.hours_flag, br, 1);
+                    if (metadata->metadata_timecode.hours_flag) {
+                        _obp_br(metadata->metadata_timecode.hours_value, br, 5);
+                    }
+                }
+            }
+        }
+        _obp_br(metadata->metadata_timecode.time_offset_length, br, 5);
+        if (metadata->metadata_timecode.time_offset_length > 0) {
+             _obp_br(metadata->metadata_timecode.time_offset_value, br, metadata->metadata_timecode.time_offset_length);
+        }
+    } else if (metadata->metadata_type >= 6 && metadata->metadata_type <= 31) {
+        metadata->unregistered.buf      = buf + consumed;
+        metadata->unregistered.buf_size = buf_size - consumed;
+    } else {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "metadata_type", 0, "Invalid metadata type: %"PRIu32"\n", metadata->metadata_type);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Parses uncompressed_header() into fh, which may be &state->prev.
+ */
+static int _obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq, OBPState *state,
+                                   int temporal_id, int spatial_id, uint32_t fields, OBPFrameHeader *fh,
+                                   int *SeenFrameHeader, OBPError *err)
+{
+    _OBPBitReader b   = _obp_new_br(buf, buf_size);
+    _OBPBitReader *br = &b;
+
+    int complete      = 0;
+
+    *SeenFrameHeader = 1;
+
+    /* uncompressed_header() */
+    uint8_t idLen = seq->idLen;
+    uint8_t allFrames = 255; /* (1 << 8) - 1 */
+    int FrameIsIntra;
+    if (seq->reduced_still_picture_header) {
+        fh->show_existing_frame = 0;
+        fh->frame_type          = OBP_KEY_FRAME;
+        FrameIsIntra            = 1;
+        fh->show_frame          = 1;
+        fh->showable_frame      = 1;
+    } else {
+        _obp_br(fh->show_existing_frame, br, 1);
         if (fh->show_existing_frame) {
             _obp_br(fh->frame_to_show_map_idx, br, 3);
             if (seq->decoder_model_info_present_flag && !seq->timing_info.equal_picture_interval) {
@@ -1059,17 +2653,20 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
             }
             fh->refresh_frame_flags = 0;
             if (seq->frame_id_numbers_present_flag) {
-                assert(idLen <= 255);
-                _obp_br(fh->display_frame_id, br, (uint8_t) idLen);
+                _obp_br(fh->display_frame_id, br, idLen);
             }
-            fh->frame_type = state->RefFrameType[fh->frame_to_show_map_idx];
+            fh->frame_type = (OBPFrameType) state->RefFrameType[fh->frame_to_show_map_idx];
             if (fh->frame_type == OBP_KEY_FRAME) {
                 fh->refresh_frame_flags = allFrames;
             }
             if (seq->film_grain_params_present) {
                 /* load_grain_params() */
-                fh->film_grain_params = state->RefGrainParams[fh->frame_to_show_map_idx];
+                if (_obp_check_ref_fields(state, fh->frame_to_show_map_idx, fields, OBP_FIELD_FILM_GRAIN, err) < 0)
+                    return -1;
+                _obp_load_grain_params(&fh->film_grain_params, state, fh->frame_to_show_map_idx);
             }
+            fh->UpscaledWidth = state->RefUpscaledWidth[fh->frame_to_show_map_idx];
+            fh->FrameHeight   = state->RefFrameHeight[fh->frame_to_show_map_idx];
             return 0;
         }
         _obp_br(fh->frame_type, br, 2);
@@ -1092,8 +2689,8 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         }
     }
     if (fh->frame_type == OBP_KEY_FRAME && fh->show_frame) {
+        state->RefValid = 0;
         for (int i = 0; i < 8; i++) {
-            state->RefValid[i]     = 0;
             state->RefOrderHint[i] = 0;
         }
         for (int i = 0; i < 7; i++) {
@@ -1120,18 +2717,17 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
     }
     if (seq->frame_id_numbers_present_flag) {
         /*PrevFrameID = current_frame_id */
-        assert(idLen <= 255);
         _obp_br(fh->current_frame_id, br, idLen);
         /* mark_ref_frames(idLen) */
         uint8_t diffLen = seq->delta_frame_id_length_minus_2 + 2;
         for (int i = 0; i < 8; i++) {
             if (fh->current_frame_id > (((uint32_t)1) << diffLen)) {
                 if (state->RefFrameId[i] > fh->current_frame_id || state->RefFrameId[i] < (fh->current_frame_id - (1 << diffLen))) {
-                    state->RefValid[i] = 0;
+                    state->RefValid &= ~(1 << i);
                 }
             } else {
                 if (state->RefFrameId[i] > fh->current_frame_id && state->RefFrameId[i] < ((1 << idLen) + fh->current_frame_id + (1 << diffLen))) {
-                    state->RefValid[i] = 0;
+                    state->RefValid &= ~(1 << i);
                 }
             }
         }
@@ -1161,7 +2757,7 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         if (fh->buffer_removal_time_present_flag) {
             for (uint8_t opNum = 0; opNum <= seq->operating_points_cnt_minus_1; opNum++) {
                 if (seq->decoder_model_present_for_this_op[opNum]) {
-                    uint8_t opPtIdc = seq->operating_point_idc[opNum];
+                    uint16_t opPtIdc = seq->operating_point_idc[opNum];
                     int inTemporalLayer = (opPtIdc >> temporal_id) & 1;
                     int inSpatialLayer = (opPtIdc >> (spatial_id + 8)) & 1;
                     if (opPtIdc == 0 || (inTemporalLayer && inSpatialLayer)) {
@@ -1185,7 +2781,7 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
             for (int i = 0; i < 8; i++) {
                 _obp_br(fh->ref_order_hint[i], br, seq->OrderHintBits);
                 if (fh->ref_order_hint[i] != state->RefOrderHint[i]) {
-                    state->RefValid[i] = 0;
+                    state->RefValid &= ~(1 << i);
                 }
             }
         }
@@ -1245,13 +2841,12 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
             _obp_br(fh->frame_refs_short_signaling, br, 1);
             if (fh->frame_refs_short_signaling) {
                 int ret;
-                char err_buf[1024];
-                OBPError error = { &err_buf[0], 1024 };
                 _obp_br(fh->last_frame_idx, br, 3);
                 _obp_br(fh->gold_frame_idx, br, 3);
-                ret = _obp_set_frame_refs(fh, seq, state, &error);
+                ret = _obp_set_frame_refs(fh, seq, state, err);
                 if (ret < 0) {
-                    snprintf(err->error, err->size, "Failed to set frame refs: %s", error.error);
+                    err->bit_pos = _obp_br_get_pos(br);
+                    _obp_error_prefix(err, "Failed to set frame refs: ");
                     return -1;
                 }
             }
@@ -1263,11 +2858,12 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
             if (seq->frame_id_numbers_present_flag) {
                 uint8_t n = seq->delta_frame_id_length_minus_2 + 2;
                 _obp_br(fh->delta_frame_id_minus_1[i], br, n);
-                uint8_t DeltaFrameId    = fh->delta_frame_id_minus_1[i] + 1;
-                uint8_t expectedFrameId = ((fh->current_frame_id + (1 << idLen) - DeltaFrameId) % (1 << idLen));
+                uint32_t DeltaFrameId    = fh->delta_frame_id_minus_1[i] + 1;
+                uint32_t expectedFrameId = ((fh->current_frame_id + (1 << idLen) - DeltaFrameId) % (1 << idLen));
                 if (state->RefFrameId[fh->ref_frame_idx[i]] != expectedFrameId) {
-                    snprintf(err->error, err->size, "state->RefFrameId[fh->ref_frame_idx[i]] != expectedFrameId (%"PRIu8" vs %"PRIu8")",
-                             state->RefFrameId[fh->ref_frame_idx[i]], expectedFrameId);
+                    _obp_error(err, OBP_ERROR_INVALID_DATA, "delta_frame_id_minus_1", _obp_br_get_pos(br),
+                               "state->RefFrameId[fh->ref_frame_idx[i]] != expectedFrameId (%"PRIu16" vs %"PRIu32")",
+                               state->RefFrameId[fh->ref_frame_idx[i]], expectedFrameId);
                     return -1;
                 }
             }
@@ -1411,20 +3007,22 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
             int refFrame = 1 + i;
             uint8_t hint = state->RefOrderHint[fh->ref_frame_idx[i]];
             state->OrderHint[refFrame] = hint;
-            if (!seq->enable_order_hint) {
-                state->RefFrameSignBias[refFrame] = 0;
+            if (!seq->enable_order_hint || _obp_get_relative_dist((int32_t) hint, (int32_t) OrderHint, seq) <= 0) {
+                state->RefFrameSignBias &= ~(1 << refFrame);
             } else {
-                state->RefFrameSignBias[refFrame] = _obp_get_relative_dist((int32_t) hint, (int32_t) OrderHint, seq);
+                state->RefFrameSignBias |= 1 << refFrame;
             }
         }
     }
+    fh->UpscaledWidth = UpscaledWidth;
+    fh->FrameHeight   = FrameHeight;
     if (seq->reduced_still_picture_header || fh->disable_cdf_update) {
         fh->disable_frame_end_update_cdf = 1;
     } else {
         _obp_br(fh->disable_frame_end_update_cdf, br, 1);
     }
-    int FeatureEnabled[8][8];
-    int16_t FeatureData[8][8];
+    int FeatureEnabled[8][8] = { { 0 } };
+    int16_t FeatureData[8][8] = { { 0 } };
     if (fh->primary_ref_frame == 7) {
         /* init_non_coeff_cdfs() not relevant to OBU parsing. */
         /* setup_past_independence() */
@@ -1450,9 +3048,12 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         /* load_cdfs() not relevant to OBU parsing. */
         /* load_previous */
         int prevFrame = fh->ref_frame_idx[fh->primary_ref_frame];
+        if (_obp_check_ref_fields(state, prevFrame, fields,
+                                  OBP_FIELD_SEGMENTATION | OBP_FIELD_LOOP_FILTER | OBP_FIELD_GLOBAL_MOTION, err) < 0)
+            return -1;
         for (int i = 0; i > 8; i++) {
             for (int j = 0; j < 6; j++) {
-                fh->global_motion_params.prev_gm_params[i][j] = state->SavedGmParams[prevFrame][i][j];
+                fh->global_motion_params.prev_gm_params[i][j] = _obp_saved_gm_param(state, prevFrame, i, j);
             }
         }
         /* load_loop_filter_params() */
@@ -1463,7 +3064,7 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         /* load_segmentation_params() */
         for (int i = 0; i < 8; i++) {
             for (int j = 0; j < 8; j++) {
-                FeatureEnabled[i][j] = state->SavedFeatureEnabled[prevFrame][i][j];
+                FeatureEnabled[i][j] = (state->SavedFeatureEnabled[prevFrame][i] >> j) & 1;
                 FeatureData[i][j]    = state->SavedFeatureData[prevFrame][i][j];
             }
         }
@@ -1473,10 +3074,12 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
                motion_field_estimation()
            }
      */
+    if (_obp_skip_from(fields, OBP_FIELD_TILE_INFO))
+        goto wrapup;
     /* tile_info() */
-    uint32_t sbCols          = seq->use_128x128_superblock ? ((MiCols + 31) >> 5) : ((MiCols + 15) >> 4);
-    uint32_t sbRows          = seq->use_128x128_superblock ? ((MiRows + 31) >> 5) : ((MiRows + 15) >> 4);
-    uint32_t sbShift         = seq->use_128x128_superblock ? 5 : 4;
+    uint32_t sbShift         = seq->sbShift;
+    uint32_t sbCols          = (MiCols + (1 << sbShift) - 1) >> sbShift;
+    uint32_t sbRows          = (MiRows + (1 << sbShift) - 1) >> sbShift;
     uint32_t sbSize          = sbShift + 2;
     uint32_t maxTileWidthSb  = 4096 >> sbSize;
     uint32_t maxTileAreaSb   = (4096 * 2304) >> (2 * sbSize);
@@ -1531,15 +3134,14 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         uint32_t i, maxTileHeightSb;
         for (i = 0; startSb < sbCols; i++) {
             int ret;
-            char err_buf[1024];
-            OBPError error = { &err_buf[0], 1024 };
             uint32_t maxWidth, sizeSb;
             uint32_t width_in_sbs_minus_1;
             /* MiColStarts[i] = startSb << sbShift; */
             maxWidth       = _OBP_MIN(sbCols - startSb, maxTileWidthSb);
-            ret            = _obp_ns(br, maxWidth, &width_in_sbs_minus_1, &error);
+            ret            = _obp_ns(br, maxWidth, &width_in_sbs_minus_1, err);
             if (ret < 0) {
-                snprintf(err->error, err->size, "Couldn't read width_in_sbs_minus_1: %s", error.error);
+                err->element = "width_in_sbs_minus_1";
+                _obp_error_prefix(err, "Couldn't read width_in_sbs_minus_1: ");
                 return -1;
             }
             sizeSb        = width_in_sbs_minus_1 + 1;
@@ -1560,15 +3162,14 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         startSb = 0;
         for (i = 0; startSb < sbRows; i++) {
             int ret;
-            char err_buf[1024];
-            OBPError error = { &err_buf[0], 1024 };
             uint32_t maxHeight, sizeSb;
             uint32_t height_in_sbs_minus_1;
             /*MiRowStarts[i] = startSb << sbShift;*/
             maxHeight      = _OBP_MIN(sbRows - startSb, maxTileHeightSb);
-            ret            = _obp_ns(br, maxHeight, &height_in_sbs_minus_1, &error);
+            ret            = _obp_ns(br, maxHeight, &height_in_sbs_minus_1, err);
             if (ret < 0) {
-                snprintf(err->error, err->size, "Couldn't read height_in_sbs_minus_1: %s", error.error);
+                err->element = "height_in_sbs_minus_1";
+                _obp_error_prefix(err, "Couldn't read height_in_sbs_minus_1: ");
                 return -1;
             }
             sizeSb   = height_in_sbs_minus_1 + 1;
@@ -1585,6 +3186,8 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
     } else {
         fh->tile_info.context_update_tile_id = 0;
     }
+    if (_obp_skip_from(fields, OBP_FIELD_QUANTIZATION))
+        goto wrapup;
     /* quantization_params() */
     _obp_br(fh->quantization_params.base_q_idx, br, 8);
     int32_t DeltaQYDc, DeltaQUDc, DeltaQUAc, DeltaQVDc, DeltaQVAc;
@@ -1636,6 +3239,8 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
             _obp_br(fh->quantization_params.qm_v, br, 4);
         }
     }
+    if (_obp_skip_from(fields, OBP_FIELD_SEGMENTATION))
+        goto wrapup;
     /* segmentation_params() */
     const uint8_t Segmentation_Feature_Bits[8] = { 8, 6, 6, 6, 6, 3, 0, 0 };
     const uint8_t Segmentation_Feature_Max[8]  = { 255, 63, 63, 63, 63, 7, 0, 0 };
@@ -1702,6 +3307,8 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
             }
         }
     }*/
+    if (_obp_skip_from(fields, OBP_FIELD_DELTA))
+        goto wrapup;
     /* delta_q_params() */
     fh->delta_q_params.delta_q_res     = 0;
     fh->delta_q_params.delta_q_present = 0;
@@ -1743,6 +3350,8 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         /* SegQMLevel not relevant to OBU parsing.*/
     }
     int AllLossless = (CodedLossless && (FrameWidth == UpscaledWidth));
+    if (_obp_skip_from(fields, OBP_FIELD_LOOP_FILTER))
+        goto wrapup;
     /* loop_filter_params() */
     if (CodedLossless || fh->allow_intrabc) {
         fh->loop_filter_params.loop_filter_delta_enabled = 1;
@@ -1759,46 +3368,17 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         }
         /* return */
     } else {
-        _obp_br(fh->loop_filter_params.loop_filter_level[0], br, 6);
-        _obp_br(fh->loop_filter_params.loop_filter_level[1], br, 6);
-        if (seq->color_config.NumPlanes > 1) {
-            if (fh->loop_filter_params.loop_filter_level[0] || fh->loop_filter_params.loop_filter_level[1]) {
-                _obp_br(fh->loop_filter_params.loop_filter_level[2], br, 6);
-                _obp_br(fh->loop_filter_params.loop_filter_level[3], br, 6);
-            }
-        }
-        _obp_br(fh->loop_filter_params.loop_filter_sharpness, br, 3);
-        _obp_br(fh->loop_filter_params.loop_filter_delta_enabled, br, 1);
-        if (fh->loop_filter_params.loop_filter_delta_enabled == 1) {
-            _obp_br(fh->loop_filter_params.loop_filter_delta_update, br, 1);
-            if (fh->loop_filter_params.loop_filter_delta_update == 1) {
-                for (int i = 0; i < 8; i++) {
-                    int update_ref_delta;
-                    _obp_br(update_ref_delta, br, 1);
-                    if (update_ref_delta) {
-                        int32_t val;
-                        ret = _obp_su(br, 7, &val, err);
-                        if (ret < 0) {
-                            return -1;
-                        }
-                        fh->loop_filter_params.loop_filter_ref_deltas[i] = val;
-                    }
-                }
-                for (int i = 0; i < 2; i++) {
-                    int update_mode_delta;
-                    _obp_br(update_mode_delta, br, 1);
-                    if (update_mode_delta) {
-                        int32_t val;
-                        ret = _obp_su(br, 7, &val, err);
-                        if (ret < 0) {
-                            return -1;
-                        }
-                        fh->loop_filter_params.loop_filter_mode_deltas[i] = val;
-                    }
-                }
-            }
+        if (_obp_br_bits_left(br) >= _OBP_LOOP_FILTER_PARAMS_MAX_BITS) {
+            ret = _obp_read_loop_filter_params(br, seq, fh, 0, err);
+        } else {
+            ret = _obp_read_loop_filter_params(br, seq, fh, 1, err);
+        }
+        if (ret < 0) {
+            return -1;
         }
     }
+    if (_obp_skip_from(fields, OBP_FIELD_CDEF))
+        goto wrapup;
     /* cdef_params() */
     if (CodedLossless || fh->allow_intrabc || !seq->enable_cdef) {
         fh->cdef_params.cdef_bits               = 0;
@@ -1809,24 +3389,18 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         /* CdefDamping not relevant to OBU parsing. */
         /* return */
     } else {
-        _obp_br(fh->cdef_params.cdef_damping_minus_3, br, 2);
-        /* CdefDamping not relevant to OBU parsing. */
-        _obp_br(fh->cdef_params.cdef_bits, br, 2);
-        for (int i = 0; i < (1 << fh->cdef_params.cdef_bits); i++) {
-            _obp_br(fh->cdef_params.cdef_y_pri_strength[i], br, 4);
-            _obp_br(fh->cdef_params.cdef_y_sec_strength[i], br, 2);
-            if (fh->cdef_params.cdef_y_sec_strength[i] == 3) {
-                fh->cdef_params.cdef_y_sec_strength[i] += 1;
-            }
-            if (seq->color_config.NumPlanes > 1) {
-                _obp_br(fh->cdef_params.cdef_uv_pri_strength[i], br, 4);
-                _obp_br(fh->cdef_params.cdef_uv_sec_strength[i], br, 2);
-                if (fh->cdef_params.cdef_uv_sec_strength[i] == 3) {
-                    fh->cdef_params.cdef_uv_sec_strength[i] += 1;
-                }
-            }
+        if (_obp_br_bits_left(br) >= _OBP_CDEF_PARAMS_MAX_BITS) {
+            ret = _obp_read_cdef_params(br, seq, fh, 0, err);
+        } else {
+            ret = _obp_read_cdef_params(br, seq, fh, 1, err);
+        }
+        if (ret < 0) {
+            return -1;
         }
     }
+    if (_obp_skip_from(fields, OBP_FIELD_LOOP_RESTORATION))
+        goto wrapup;
+    /* lr_params() */
     if (AllLossless || fh->allow_intrabc || !seq->enable_restoration) {
         fh->lr_params.lr_type[0] = 0;
         fh->lr_params.lr_type[1] = 0;
@@ -1864,6 +3438,8 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
             /* LoopRestorationSize not relevant to OBU parsing. */
         }
     }
+    if (_obp_skip_from(fields, OBP_FIELD_MODE_INFO))
+        goto wrapup;
     /* read_tx_mode */
     if (CodedLossless == 1) {
         /* TxMode not relevant to OBU parsing. */
@@ -1940,6 +3516,8 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         _obp_br(fh->allow_warped_motion, br, 1);
     }
     _obp_br(fh->reduced_tx_set, br, 1);
+    if (_obp_skip_from(fields, OBP_FIELD_GLOBAL_MOTION))
+        goto wrapup;
     /* global_motion_params() */
     for (int ref = 1; ref < 7; ref++) {
         fh->global_motion_params.gm_type[ref] = 0;
@@ -2004,6 +3582,8 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
             }
         }
     }
+    if (_obp_skip_from(fields, OBP_FIELD_FILM_GRAIN))
+        goto wrapup;
     /* film_grain_params() */
     if (!seq->film_grain_params_present || (!fh->show_frame && !fh->showable_frame)) {
         /* reset_grain_params() */
@@ -2026,7 +3606,10 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
                 _obp_br(fh->film_grain_params.film_grain_params_ref_idx, br, 3);
                 uint16_t tempGrainSeed = fh->film_grain_params.grain_seed;
                 /* load_grain_params() */
-                fh->film_grain_params            = state->RefGrainParams[fh->film_grain_params.film_grain_params_ref_idx];
+                if (_obp_check_ref_fields(state, fh->film_grain_params.film_grain_params_ref_idx, fields,
+                                          OBP_FIELD_FILM_GRAIN, err) < 0)
+                    return -1;
+                _obp_load_grain_params(&fh->film_grain_params, state, fh->film_grain_params.film_grain_params_ref_idx);
                 fh->film_grain_params.grain_seed = tempGrainSeed;
                 /* return */
             } else {
@@ -2097,60 +3680,719 @@ int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq
         }
     }
 
-    /* Stash refs for future frame use. */
-    /* decode_frame_wrapup() */
+    complete = 1;
+
+wrapup:
+    /* Stash refs for future frame use. */
+    /* decode_frame_wrapup() */
+    for (int i = 0; i < 8; i++) {
+        if ((fh->refresh_frame_flags >> i) & 1) {
+            state->RefOrderHint[i]     = fh->order_hint;
+            state->RefFrameType[i]     = (uint8_t) fh->frame_type;
+            state->RefUpscaledWidth[i] = UpscaledWidth;
+            state->RefFrameHeight[i]   = FrameHeight;
+            state->RefRenderWidth[i]   = fh->RenderWidth;
+            state->RefRenderHeight[i]  = fh->RenderHeight;
+            state->RefFrameId[i]       = (uint16_t) fh->current_frame_id;
+            state->RefValid           |= 1 << i;
+            state->RefSkippedFields[i] = (uint16_t) (OBP_FIELDS_ALL & ~_obp_parsed_fields(fields));
+            /* save_grain_params() */
+            if (fh->film_grain_params.apply_grain) {
+                state->RefGrainParams[i] = fh->film_grain_params;
+                state->RefApplyGrain    |= 1 << i;
+            } else {
+                state->RefApplyGrain &= ~(1 << i);
+            }
+            /* save_global_motion_params() */
+            for (int j = 1; j < 8; j++) {
+                for (int k = 0; k < 6; k++) {
+                    state->SavedGmParams[i][j - 1][k] = fh->global_motion_params.gm_params[j][k];
+                }
+            }
+            /* save_segmentation_params() */
+            for (int j = 0; j < 8; j++) {
+                state->SavedFeatureEnabled[i][j] = 0;
+                for (int k = 0; k < 8; k++) {
+                    state->SavedFeatureEnabled[i][j] |= (FeatureEnabled[j][k] != 0) << k;
+                    state->SavedFeatureData[i][j][k]  = FeatureData[j][k];
+                }
+            }
+            /* save_loop_filter_params() */
+            for (int j = 0; j < 8; j++) {
+                state->SavedLoopFilterRefDeltas[i][j]  = fh->loop_filter_params.loop_filter_ref_deltas[j];
+                state->SavedLoopFilterModeDeltas[i][j] = fh->loop_filter_params.loop_filter_mode_deltas[j];
+            }
+        }
+    }
+
+    /* Handle show_existing_frame semantics. */
+    /* decode_frame_wrapup() */
+    if (fh->show_existing_frame && fh->frame_type == OBP_KEY_FRAME) {
+        fh->order_hint = state->RefOrderHint[fh->frame_to_show_map_idx];
+        for (int i = 0; i < 8; i++) {
+            for (int j = 0; j < 6; j++) {
+                fh->global_motion_params.gm_params[i][j] = _obp_saved_gm_param(state, fh->frame_to_show_map_idx, i, j);
+            }
+        }
+    }
+    if (fh->show_existing_frame || !complete) {
+        /* A partially parsed header can't stand in for redundant copies of itself. */
+        *SeenFrameHeader = 0;
+        state->prev_filled = 0;
+    } else {
+        if (fh != &state->prev)
+            state->prev = *fh;
+        state->prev_filled = 1;
+    }
+
+    /* Stash byte position for use in OBU_FRAME parsing. */
+    _obp_br_byte_alignment(br);
+    state->frame_header_end_pos = complete ? _obp_br_get_pos(br) : 0;
+
+    return 0;
+}
+
+/*
+ * Parses the tile group following the frame header in a frame OBU.
+ */
+static int _obp_parse_frame_tile_group(uint8_t *buf, size_t buf_size, OBPState *state, OBPFrameHeader *fh,
+                                       OBPTileGroup *tile_group, int *SeenFrameHeader, OBPError *err)
+{
+    size_t startBitPos = 0, endBitPos, headerBytes;
+    int ret;
+
+    endBitPos   = state->frame_header_end_pos;
+    headerBytes = (endBitPos - startBitPos) / 8;
+    ret         = _obp_parse_tile_group(buf + headerBytes, buf_size - headerBytes, headerBytes, fh, tile_group, 0,
+                                        SeenFrameHeader, err);
+    if (ret < 0) {
+        err->bit_pos += headerBytes * 8;
+        return -1;
+    }
+    return 0;
+}
+
+int obp_parse_frame(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq, OBPState *state,
+                    int temporal_id, int spatial_id, OBPFrameHeader *fh, OBPTileGroup *tile_group,
+                    int *SeenFrameHeader, OBPError *err)
+{
+    int ret = obp_parse_frame_header(buf, buf_size, seq, state, temporal_id, spatial_id, fh, SeenFrameHeader, err);
+    if (ret < 0) {
+        return -1;
+    }
+    return _obp_parse_frame_tile_group(buf, buf_size, state, fh, tile_group, SeenFrameHeader, err);
+}
+
+int obp_parse_frame_ref(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq, OBPState *state,
+                        int temporal_id, int spatial_id, const OBPFrameHeader **frame_header, OBPTileGroup *tile_group,
+                        int *SeenFrameHeader, OBPError *err)
+{
+    int ret = obp_parse_frame_header_ref(buf, buf_size, seq, state, temporal_id, spatial_id, frame_header,
+                                         SeenFrameHeader, err);
+    if (ret < 0) {
+        return -1;
+    }
+    return _obp_parse_frame_tile_group(buf, buf_size, state, &state->prev, tile_group, SeenFrameHeader, err);
+}
+
+int obp_parse_frame_no_tiles(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq, OBPState *state,
+                             int temporal_id, int spatial_id, OBPFrameHeader *fh, size_t *tile_group_offset,
+                             size_t *tile_group_size, int *SeenFrameHeader, OBPError *err)
+{
+    OBPTileGroup tile_group = { 0 };
+    size_t headerBytes;
+    int ret;
+
+    ret = obp_parse_frame_header(buf, buf_size, seq, state, temporal_id, spatial_id, fh, SeenFrameHeader, err);
+    if (ret < 0)
+        return -1;
+
+    headerBytes = state->frame_header_end_pos / 8;
+    ret         = _obp_parse_tile_group(buf + headerBytes, buf_size - headerBytes, headerBytes, fh, &tile_group, 1,
+                                        SeenFrameHeader, err);
+    if (ret < 0) {
+        err->bit_pos += headerBytes * 8;
+        return -1;
+    }
+
+    *tile_group_offset = headerBytes;
+    *tile_group_size   = buf_size - headerBytes;
+
+    return 0;
+}
+
+int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq, OBPState *state,
+                           int temporal_id, int spatial_id, OBPFrameHeader *fh, int *SeenFrameHeader, OBPError *err)
+{
+    if (*SeenFrameHeader == 1) {
+        if (!state->prev_filled) {
+            _obp_error(err, OBP_ERROR_INVALID_STATE, NULL, 0, "SeenFrameHeader is one, but no previous header exists in state.");
+            return -1;
+        }
+        *fh = state->prev;
+        return 0;
+    }
+
+    return _obp_parse_frame_header(buf, buf_size, seq, state, temporal_id, spatial_id, OBP_FIELDS_ALL, fh,
+                                   SeenFrameHeader, err);
+}
+
+int obp_parse_frame_header_fields(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq, OBPState *state,
+                                  int temporal_id, int spatial_id, uint32_t fields, OBPFrameHeader *fh,
+                                  int *SeenFrameHeader, OBPError *err)
+{
+    if (*SeenFrameHeader == 1 && !_obp_skip_from(fields, OBP_FIELD_FILM_GRAIN)) {
+        if (!state->prev_filled) {
+            _obp_error(err, OBP_ERROR_INVALID_STATE, NULL, 0, "SeenFrameHeader is one, but no previous header exists in state.");
+            return -1;
+        }
+        *fh = state->prev;
+        return 0;
+    }
+
+    return _obp_parse_frame_header(buf, buf_size, seq, state, temporal_id, spatial_id, fields & OBP_FIELDS_ALL, fh,
+                                   SeenFrameHeader, err);
+}
+
+int obp_parse_frame_header_ref(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq, OBPState *state,
+                               int temporal_id, int spatial_id, const OBPFrameHeader **frame_header,
+                               int *SeenFrameHeader, OBPError *err)
+{
+    int ret;
+
+    if (*SeenFrameHeader == 1) {
+        if (!state->prev_filled) {
+            _obp_error(err, OBP_ERROR_INVALID_STATE, NULL, 0, "SeenFrameHeader is one, but no previous header exists in state.");
+            return -1;
+        }
+        *frame_header = &state->prev;
+        return 0;
+    }
+
+    /* The header is parsed in place, so the previous one is gone either way. */
+    state->prev_filled = 0;
+    memset(&state->prev, 0, sizeof(state->prev));
+
+    ret = _obp_parse_frame_header(buf, buf_size, seq, state, temporal_id, spatial_id, OBP_FIELDS_ALL, &state->prev,
+                                  SeenFrameHeader, err);
+    if (ret < 0)
+        return -1;
+
+    *frame_header = &state->prev;
+
+    return 0;
+}
+
+int obp_state_serialize(OBPState *state, uint8_t *buf, size_t buf_size, size_t *size, OBPError *err)
+{
+    size_t pos = 0;
+
+    if (buf_size < OBP_STATE_SNAPSHOT_MAX_SIZE) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Snapshot buffer is too small: %zu bytes.", buf_size);
+        return -1;
+    }
+
+    _obp_put_le(buf, &pos, _OBP_SNAPSHOT_VERSION, 1);
+    _obp_put_le(buf, &pos, state->RefValid, 1);
+    _obp_put_le(buf, &pos, state->RefFrameSignBias, 1);
+    _obp_put_le(buf, &pos, state->RefApplyGrain, 1);
+    for (int i = 0; i < 8; i++) {
+        _obp_put_le(buf, &pos, state->OrderHint[i], 1);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        size_t gm_mask_pos = pos;
+        uint8_t gm_mask    = 0;
+
+        _obp_put_le(buf, &pos, state->RefFrameType[i], 1);
+        _obp_put_le(buf, &pos, state->RefOrderHint[i], 1);
+        _obp_put_le(buf, &pos, state->RefFrameId[i], 2);
+        _obp_put_le(buf, &pos, state->RefSkippedFields[i], 2);
+        _obp_put_leb128(buf, &pos, state->RefUpscaledWidth[i]);
+        _obp_put_leb128(buf, &pos, state->RefFrameHeight[i]);
+        _obp_put_leb128(buf, &pos, state->RefRenderWidth[i]);
+        _obp_put_leb128(buf, &pos, state->RefRenderHeight[i]);
+
+        /* Only global motion parameters which differ from the identity are stored. */
+        gm_mask_pos = pos;
+        pos++;
+        for (int j = 0; j < 7; j++) {
+            int identity = 1;
+            for (int k = 0; k < 6; k++) {
+                if (state->SavedGmParams[i][j][k] != ((k % 3 == 2) ? (((int32_t)1) << 16) : 0))
+                    identity = 0;
+            }
+            if (identity)
+                continue;
+            gm_mask |= 1 << j;
+            for (int k = 0; k < 6; k++) {
+                _obp_put_le(buf, &pos, (uint32_t) state->SavedGmParams[i][j][k], 4);
+            }
+        }
+        buf[gm_mask_pos] = gm_mask;
+
+        for (int j = 0; j < 8; j++) {
+            _obp_put_le(buf, &pos, state->SavedFeatureEnabled[i][j], 1);
+            for (int k = 0; k < 8; k++) {
+                if ((state->SavedFeatureEnabled[i][j] >> k) & 1)
+                    _obp_put_le(buf, &pos, (uint16_t) state->SavedFeatureData[i][j][k], 2);
+            }
+        }
+        for (int j = 0; j < 8; j++) {
+            _obp_put_le(buf, &pos, (uint8_t) state->SavedLoopFilterRefDeltas[i][j], 1);
+        }
+        for (int j = 0; j < 8; j++) {
+            _obp_put_le(buf, &pos, (uint8_t) state->SavedLoopFilterModeDeltas[i][j], 1);
+        }
+
+        if ((state->RefApplyGrain >> i) & 1)
+            _obp_put_grain_params(buf, &pos, &state->RefGrainParams[i]);
+    }
+
+    *size = pos;
+
+    return 0;
+}
+
+int obp_state_deserialize(uint8_t *buf, size_t buf_size, OBPState *state, OBPError *err)
+{
+    size_t pos = 0;
+    uint8_t version;
+
+    memset(state, 0, sizeof(*state));
+
+    _obp_snap_get(version, 1);
+    if (version != _OBP_SNAPSHOT_VERSION) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "version", 0, "Unsupported state snapshot version: %"PRIu8".", version);
+        return -1;
+    }
+    _obp_snap_get(state->RefValid, 1);
+    _obp_snap_get(state->RefFrameSignBias, 1);
+    _obp_snap_get(state->RefApplyGrain, 1);
     for (int i = 0; i < 8; i++) {
-        if ((fh->refresh_frame_flags >> i) & 1) {
-            state->RefOrderHint[i]     = fh->order_hint;
-            state->RefFrameType[i]     = fh->frame_type;
-            state->RefUpscaledWidth[i] = UpscaledWidth;
-            state->RefFrameHeight[i]   = FrameHeight;
-            state->RefRenderWidth[i]   = fh->RenderWidth;
-            state->RefRenderHeight[i]  = fh->RenderHeight;
-            state->RefFrameId[i]       = fh->current_frame_id;
-            state->RefGrainParams[i]   = fh->film_grain_params;
-            /* save_grain_params() */
-            for (int j = 0; j < 8; j++) {
-                for (int k = 0; k < 6; k++) {
-                    state->SavedGmParams[i][j][k] = fh->global_motion_params.gm_params[j][k];
+        _obp_snap_get(state->OrderHint[i], 1);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        uint8_t gm_mask;
+
+        _obp_snap_get(state->RefFrameType[i], 1);
+        if (state->RefFrameType[i] > OBP_SWITCH_FRAME) {
+            _obp_error(err, OBP_ERROR_INVALID_DATA, "RefFrameType", (pos - 1) * 8,
+                       "Invalid reference frame type: %"PRIu8".", state->RefFrameType[i]);
+            return -1;
+        }
+        _obp_snap_get(state->RefOrderHint[i], 1);
+        _obp_snap_get(state->RefFrameId[i], 2);
+        _obp_snap_get(state->RefSkippedFields[i], 2);
+        if (state->RefSkippedFields[i] & ~OBP_FIELDS_ALL) {
+            _obp_error(err, OBP_ERROR_INVALID_DATA, "RefSkippedFields", pos * 8,
+                       "Invalid skipped field groups: 0x%"PRIx16".", state->RefSkippedFields[i]);
+            return -1;
+        }
+        _obp_snap_get_leb128(state->RefUpscaledWidth[i]);
+        _obp_snap_get_leb128(state->RefFrameHeight[i]);
+        _obp_snap_get_leb128(state->RefRenderWidth[i]);
+        _obp_snap_get_leb128(state->RefRenderHeight[i]);
+
+        _obp_snap_get(gm_mask, 1);
+        for (int j = 0; j < 7; j++) {
+            for (int k = 0; k < 6; k++) {
+                if ((gm_mask >> j) & 1) {
+                    uint32_t param;
+                    _obp_snap_get(param, 4);
+                    state->SavedGmParams[i][j][k] = (int32_t) param;
+                } else {
+                    state->SavedGmParams[i][j][k] = (k % 3 == 2) ? (((int32_t)1) << 16) : 0;
                 }
             }
-            /* save_segmentation_params() */
-            for (int j = 0; j < 8; j++) {
-                for (int k = 0; k < 8; k++) {
-                    state->SavedFeatureEnabled[i][j][k] = FeatureEnabled[j][k];
-                    state->SavedFeatureData[i][j][k]    = FeatureData[j][k];
+        }
+
+        for (int j = 0; j < 8; j++) {
+            _obp_snap_get(state->SavedFeatureEnabled[i][j], 1);
+            for (int k = 0; k < 8; k++) {
+                if ((state->SavedFeatureEnabled[i][j] >> k) & 1) {
+                    uint16_t data;
+                    _obp_snap_get(data, 2);
+                    state->SavedFeatureData[i][j][k] = (int16_t) data;
                 }
             }
-            /* save_loop_filter_params() */
-            for (int j = 0; j < 8; j++) {
-                state->SavedLoopFilterRefDeltas[i][j]  = fh->loop_filter_params.loop_filter_ref_deltas[j];
-                state->SavedLoopFilterModeDeltas[i][j] = fh->loop_filter_params.loop_filter_mode_deltas[j];
-            }
+        }
+        for (int j = 0; j < 8; j++) {
+            uint8_t delta;
+            _obp_snap_get(delta, 1);
+            state->SavedLoopFilterRefDeltas[i][j] = (int8_t) delta;
+        }
+        for (int j = 0; j < 8; j++) {
+            uint8_t delta;
+            _obp_snap_get(delta, 1);
+            state->SavedLoopFilterModeDeltas[i][j] = (int8_t) delta;
+        }
+
+        if ((state->RefApplyGrain >> i) & 1) {
+            if (_obp_get_grain_params(buf, buf_size, &pos, &state->RefGrainParams[i], err) < 0)
+                return -1;
         }
     }
 
-    /* Handle show_existing_frame semantics. */
-    /* decode_frame_wrapup() */
-    if (fh->show_existing_frame && fh->frame_type == OBP_KEY_FRAME) {
-        fh->order_hint = state->RefOrderHint[fh->frame_to_show_map_idx];
-        for (int i = 0; i < 8; i++) {
-            for (int j = 0; j < 6; j++) {
-                fh->global_motion_params.gm_params[i][j] = state->SavedGmParams[fh->frame_to_show_map_idx][i][j];
-            }
+    return 0;
+}
+
+int obp_level_verifier_init(OBPLevelVerifier *verifier, OBPSequenceHeader *seq_header, int operating_point,
+                            uint32_t timebase_num, uint32_t timebase_den, OBPError *err)
+{
+    static const uint32_t pic_size_profile_factor[3] = { 15, 30, 36 };
+    uint8_t level;
+    int tier;
+
+    if (operating_point < 0 || operating_point > seq_header->operating_points_cnt_minus_1) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Invalid operating point: %d.", operating_point);
+        return -1;
+    }
+    if (timebase_num == 0 || timebase_den == 0) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Invalid timebase: %"PRIu32"/%"PRIu32".",
+                   timebase_num, timebase_den);
+        return -1;
+    }
+    if (seq_header->seq_profile > 2) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "seq_profile", 0, "Unsupported seq_profile: %"PRIu8".",
+                   seq_header->seq_profile);
+        return -1;
+    }
+
+    level = seq_header->seq_level_idx[operating_point];
+    tier  = seq_header->seq_tier[operating_point];
+
+    memset(verifier, 0, sizeof(*verifier));
+
+    if (level == 31) {
+        verifier->unconstrained = 1;
+    } else if (level >= 24 || _obp_levels[level].MaxPicSize == 0) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, "seq_level_idx", 0, "Reserved seq_level_idx: %"PRIu8".", level);
+        return -1;
+    } else {
+        uint64_t bitrate_profile_factor = (uint64_t) seq_header->seq_profile + 1;
+        uint16_t mbps                   = tier && _obp_levels[level].HighMbps ? _obp_levels[level].HighMbps : _obp_levels[level].MainMbps;
+
+        verifier->limits.MaxPicSize          = _obp_levels[level].MaxPicSize;
+        verifier->limits.MaxHSize            = _obp_levels[level].MaxHSize;
+        verifier->limits.MaxVSize            = _obp_levels[level].MaxVSize;
+        verifier->limits.MaxDisplayRate      = _obp_levels[level].MaxDisplayRate;
+        verifier->limits.MaxDecodeRate       = _obp_levels[level].MaxDecodeRate;
+        verifier->limits.MaxHeaderRate       = _obp_levels[level].MaxHeaderRate;
+        verifier->limits.MaxBitrate          = (uint64_t) mbps * 100000 * bitrate_profile_factor;
+        verifier->limits.MinPicCompressRatio = tier ? _obp_levels[level].HighCR : _obp_levels[level].MainCR;
+        verifier->limits.MaxTiles            = _obp_levels[level].MaxTiles;
+        verifier->limits.MaxTileCols         = _obp_levels[level].MaxTileCols;
+    }
+
+    verifier->idc                     = seq_header->operating_point_idc[operating_point];
+    verifier->operating_point         = operating_point;
+    verifier->timebase_num            = timebase_num;
+    verifier->timebase_den            = timebase_den;
+    verifier->pic_size_profile_factor = pic_size_profile_factor[seq_header->seq_profile];
+    verifier->still_picture           = seq_header->still_picture;
+
+    /* Annex C defaults, in 1/90000 seconds, for when there is no decoder model. */
+    verifier->decoder_buffer_delay = 70000.0 / 90000.0;
+    verifier->buffer_delay         = (70000.0 + 20000.0) / 90000.0;
+
+    if (seq_header->decoder_model_info_present_flag && seq_header->decoder_model_present_for_this_op[operating_point] &&
+        seq_header->timing_info.time_scale != 0) {
+        uint64_t decoder_buffer_delay = seq_header->operating_parameters_info[operating_point].decoder_buffer_delay;
+        uint64_t encoder_buffer_delay = seq_header->operating_parameters_info[operating_point].encoder_buffer_delay;
+
+        verifier->decoder_model               = 1;
+        verifier->low_delay_mode              = seq_header->operating_parameters_info[operating_point].low_delay_mode_flag;
+        verifier->decoding_tick               = (double) seq_header->decoder_model_info.num_units_in_decoding_tick /
+                                                (double) seq_header->timing_info.time_scale;
+        verifier->decoder_buffer_delay        = (double) decoder_buffer_delay / 90000.0;
+        verifier->buffer_delay                = (double) (decoder_buffer_delay + encoder_buffer_delay) / 90000.0;
+        verifier->buffer_removal_time_modulus = ((uint64_t) 1) << (seq_header->decoder_model_info.buffer_removal_time_length_minus_1 + 1);
+    }
+
+    return 0;
+}
+
+int obp_level_verifier_push_frame(OBPLevelVerifier *verifier, OBPFrameHeader *frame_header, int temporal_id,
+                                  int spatial_id, int64_t pts, size_t coded_size, uint32_t *violations,
+                                  OBPError *err)
+{
+    OBPLevelLimits *limits = &verifier->limits;
+    uint32_t failed        = 0;
+    int decoded            = !frame_header->show_existing_frame;
+    int displayed          = frame_header->show_existing_frame || frame_header->show_frame;
+    uint64_t samples       = (uint64_t) frame_header->UpscaledWidth * frame_header->FrameHeight;
+    double time, removal, first_bit_arrival;
+    size_t end;
+
+    *violations = 0;
+
+    if (verifier->idc != 0) {
+        int inTemporalLayer = (verifier->idc >> temporal_id) & 1;
+        int inSpatialLayer  = (verifier->idc >> (spatial_id + 8)) & 1;
+        if (!inTemporalLayer || !inSpatialLayer)
+            return 0;
+    }
+
+    if (verifier->num_frames == 0) {
+        verifier->first_pts = pts;
+    } else if (pts < verifier->last_pts) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Timestamp decreased: %"PRId64" after %"PRId64".",
+                   pts, verifier->last_pts);
+        return -1;
+    }
+
+    time = (double) (pts - verifier->first_pts) * verifier->timebase_num / verifier->timebase_den;
+
+    /* Sizes and tiles. */
+    if (decoded) {
+        if (samples > limits->MaxPicSize)
+            failed |= OBP_LEVEL_PIC_SIZE;
+        if (frame_header->UpscaledWidth > limits->MaxHSize)
+            failed |= OBP_LEVEL_H_SIZE;
+        if (frame_header->FrameHeight > limits->MaxVSize)
+            failed |= OBP_LEVEL_V_SIZE;
+        if ((uint32_t) frame_header->tile_info.TileCols * frame_header->tile_info.TileRows > limits->MaxTiles)
+            failed |= OBP_LEVEL_TILES;
+        if (frame_header->tile_info.TileCols > limits->MaxTileCols)
+            failed |= OBP_LEVEL_TILE_COLS;
+    }
+
+    /* Rates over the last second. */
+    _obp_level_evict(verifier, time);
+    if (verifier->window_count == OBP_LEVEL_WINDOW_FRAMES) {
+        /* More frames than any level allows in one second; make room by dropping the oldest. */
+        failed |= OBP_LEVEL_HEADER_RATE;
+        verifier->window_decoded   -= verifier->window[verifier->window_start].decoded;
+        verifier->window_displayed -= verifier->window[verifier->window_start].displayed;
+        verifier->window_start      = (verifier->window_start + 1) % OBP_LEVEL_WINDOW_FRAMES;
+        verifier->window_count--;
+    }
+    end = (verifier->window_start + verifier->window_count) % OBP_LEVEL_WINDOW_FRAMES;
+    verifier->window[end].time      = time;
+    verifier->window[end].decoded   = decoded ? samples : 0;
+    verifier->window[end].displayed = displayed ? samples : 0;
+    verifier->window_decoded       += verifier->window[end].decoded;
+    verifier->window_displayed     += verifier->window[end].displayed;
+    verifier->window_count++;
+
+    if (verifier->window_displayed > limits->MaxDisplayRate)
+        failed |= OBP_LEVEL_DISPLAY_RATE;
+    if (verifier->window_decoded > limits->MaxDecodeRate)
+        failed |= OBP_LEVEL_DECODE_RATE;
+    if (verifier->window_count > limits->MaxHeaderRate)
+        failed |= OBP_LEVEL_HEADER_RATE;
+
+    verifier->peak_display_rate = _OBP_MAX(verifier->peak_display_rate, verifier->window_displayed);
+    verifier->peak_decode_rate  = _OBP_MAX(verifier->peak_decode_rate, verifier->window_decoded);
+    verifier->peak_header_rate  = _OBP_MAX(verifier->peak_header_rate, (uint32_t) verifier->window_count);
+
+    /* Compression ratio. */
+    if (decoded && coded_size > 0) {
+        double ratio     = (double) ((samples * verifier->pic_size_profile_factor) >> 3) / (double) coded_size;
+        double min_ratio = 0.8;
+
+        if (!verifier->still_picture && limits->MaxDecodeRate != 0) {
+            double speed_adj = (double) verifier->window_decoded / (double) limits->MaxDecodeRate;
+            min_ratio = _OBP_MAX(0.8, limits->MinPicCompressRatio * speed_adj);
         }
+        if (ratio < min_ratio)
+            failed |= OBP_LEVEL_COMPRESSION_RATIO;
+
+        if (verifier->min_compress_ratio == 0.0 || ratio < verifier->min_compress_ratio)
+            verifier->min_compress_ratio = ratio;
     }
-    if (fh->show_existing_frame) {
-        *SeenFrameHeader = 0;
-        state->prev_filled = 0;
+
+    /* Smoothing buffer. */
+    removal           = _obp_level_removal_time(verifier, frame_header, verifier->operating_point, time);
+    first_bit_arrival = _OBP_MAX(verifier->last_bit_arrival, removal - verifier->buffer_delay);
+    if (limits->MaxBitrate != 0) {
+        double slack;
+
+        verifier->last_bit_arrival = first_bit_arrival + (double) coded_size * 8.0 / (double) limits->MaxBitrate;
+
+        slack = removal - verifier->last_bit_arrival;
+        if (!verifier->low_delay_mode && slack < -_OBP_LEVEL_TIME_EPSILON)
+            failed |= OBP_LEVEL_BUFFER_UNDERFLOW;
+        if (verifier->num_frames == 0 || slack < verifier->min_buffer_slack)
+            verifier->min_buffer_slack = slack;
+    }
+    verifier->last_removal = removal;
+    verifier->last_time    = time;
+    verifier->last_pts     = pts;
+    verifier->num_frames++;
+
+    if (verifier->unconstrained)
+        failed = 0;
+
+    verifier->violations |= failed;
+    *violations           = failed;
+
+    return 0;
+}
+
+int obp_seek_index_push_frame(OBPSeekIndexBuilder *builder, OBPFrameHeader *frame_header, int64_t pts,
+                              uint64_t offset, int has_seq_header, OBPSeekPoint *point, int *has_point,
+                              OBPError *err)
+{
+    int is_key         = frame_header->frame_type == OBP_KEY_FRAME;
+    OBPSeekPoint found = { pts, 0, 0 };
+    int found_point    = 0;
+
+    *has_point = 0;
+
+    if (frame_header->show_existing_frame) {
+        uint8_t idx = frame_header->frame_to_show_map_idx;
+        if (is_key && ((builder->pending >> idx) & 1)) {
+            found.offset            = builder->pending_offset[idx];
+            found.forward_key_frame = 1;
+            found_point             = 1;
+        }
+    } else if (is_key && frame_header->show_frame && has_seq_header) {
+        found.offset = offset;
+        found_point  = 1;
+    }
+
+    /* Any refreshed slot now holds either a new hidden key frame, or nothing to seek to. */
+    if (!frame_header->show_existing_frame && is_key && !frame_header->show_frame && has_seq_header) {
+        for (int i = 0; i < 8; i++) {
+            if ((frame_header->refresh_frame_flags >> i) & 1)
+                builder->pending_offset[i] = offset;
+        }
+        builder->pending |= frame_header->refresh_frame_flags;
     } else {
-        state->prev = *fh;
-        state->prev_filled = 1;
+        builder->pending &= (uint8_t) ~frame_header->refresh_frame_flags;
     }
 
-    /* Stash byte position for use in OBU_FRAME parsing. */
-    _obp_br_byte_alignment(br);
-    state->frame_header_end_pos = _obp_br_get_pos(br);
+    if (!found_point)
+        return 0;
+
+    /* Other frames of the same temporal unit, e.g. other spatial layers, add nothing. */
+    if (builder->num_points > 0 && builder->last_point.pts == found.pts && builder->last_point.offset == found.offset)
+        return 0;
+
+    if (builder->num_points > 0 && found.pts < builder->last_point.pts) {
+        _obp_error(err, OBP_ERROR_INVALID_DATA, NULL, 0,
+                   "Random access point timestamp decreased: %"PRId64" after %"PRId64".", found.pts,
+                   builder->last_point.pts);
+        return -1;
+    }
+
+    builder->last_point = found;
+    builder->num_points++;
+
+    *point     = found;
+    *has_point = 1;
+
+    return 0;
+}
+
+int obp_seek_index_write_header(uint64_t num_points, uint8_t *buf, size_t buf_size, OBPError *err)
+{
+    size_t pos = 0;
+
+    if (buf_size < OBP_SEEK_INDEX_HEADER_SIZE) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Seek index header buffer is too small: %zu bytes.", buf_size);
+        return -1;
+    }
+
+    memcpy(buf, "OBPI", 4);
+    pos += 4;
+    _obp_put_be(buf, &pos, _OBP_SEEK_INDEX_VERSION, 1);
+    _obp_put_be(buf, &pos, 0, 3);
+    _obp_put_be(buf, &pos, num_points, 8);
+
+    return 0;
+}
+
+int obp_seek_index_write_point(OBPSeekPoint *point, uint8_t *buf, size_t buf_size, OBPError *err)
+{
+    size_t pos = 0;
+
+    if (buf_size < OBP_SEEK_INDEX_POINT_SIZE) {
+        _obp_error(err, OBP_ERROR_INVALID_ARGUMENT, NULL, 0, "Seek index point buffer is too small: %zu bytes.", buf_size);
+        return -1;
+    }
+
+    _obp_put_be(buf, &pos, (uint64_t) point->pts, 8);
+    _obp_put_be(buf, &pos, point->offset, 8);
+    _obp_put_be(buf, &pos, point->forward_key_frame ? 1 : 0, 1);
+
+    return 0;
+}
+
+int obp_seek_index_get_point(uint8_t *buf, size_t buf_size, uint64_t index, uint64_t *num_points,
+                             OBPSeekPoint *point, OBPError *err)
+{
+    uint64_t count;
+
+    if (_obp_seek_index_check(buf, buf_size, &count, err) < 0)
+        return -1;
+
+    if (num_points != NULL)
+        *num_points = count;
+
+    if (index >= count) {
+        _obp_error(err, OBP_ERROR_NOT_FOUND, NULL, 0, "Seek index point %"PRIu64" out of range: %"PRIu64" points.",
+                   index, count);
+        return -1;
+    }
+
+    _obp_get_seek_point(buf, index, point);
+
+    return 0;
+}
+
+int obp_seek_index_lookup(uint8_t *buf, size_t buf_size, int64_t pts, uint64_t *index, OBPSeekPoint *point,
+                          OBPError *err)
+{
+    uint64_t count, low = 0, high;
+    OBPSeekPoint p;
+
+    if (_obp_seek_index_check(buf, buf_size, &count, err) < 0)
+        return -1;
+
+    /* Find the first point after pts; the one before it is the answer. */
+    high = count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        _obp_get_seek_point(buf, mid, &p);
+        if (p.pts <= pts)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == 0) {
+        _obp_error(err, OBP_ERROR_NOT_FOUND, NULL, 0, "No random access point at or before %"PRId64".", pts);
+        return -1;
+    }
+
+    _obp_get_seek_point(buf, low - 1, point);
+    if (index != NULL)
+        *index = low - 1;
 
     return 0;
 }
+
+void obp_strerror(const OBPError *err, char *buf, size_t size)
+{
+    static const char *const descriptions[] = {
+        "No error",
+        "Ran out of bytes in buffer",
+        "Invalid value in bitstream",
+        "Invalid parser state",
+        "Invalid argument",
+        "Not found"
+    };
+    const char *desc = "Unknown error";
+
+    if ((size_t) err->code < sizeof(descriptions) / sizeof(descriptions[0]))
+        desc = descriptions[err->code];
+
+    if (err->element != NULL)
+        snprintf(buf, size, "%s while reading %s, at bit %zu.", desc, err->element, err->bit_pos);
+    else
+        snprintf(buf, size, "%s, at bit %zu.", desc, err->bit_pos);
+}
@@ -172,7 +172,7 @@ typedef struct OBPSequenceHeader {
     } decoder_model_info;
     int initial_display_delay_present_flag;
     uint8_t operating_points_cnt_minus_1;
-    uint8_t operating_point_idc[32];
+    uint16_t operating_point_idc[32];
     uint8_t seq_level_idx[32];
     uint8_t seq_tier[32];
     int decoder_model_present_for_this_op[32];
@@ -226,6 +226,17 @@ typedef struct OBPSequenceHeader {
         int separate_uv_delta_q;
     } color_config;
     int film_grain_params_present;
+
+    /*
+     * Values derived from the fields above, filled in by obp_parse_sequence_header so that
+     * they are not recomputed for every frame header. Read-only.
+     */
+    uint8_t idLen;              /* additional_frame_id_length_minus_1 + delta_frame_id_length_minus_2 + 3, or 0. */
+    uint32_t OrderHintSignBit;  /* 1 << (OrderHintBits - 1), or 0 if enable_order_hint is 0. */
+    uint32_t OrderHintLowMask;  /* OrderHintSignBit - 1, or 0 if enable_order_hint is 0. */
+    uint8_t sbShift;            /* log2 of the superblock size, in units of MI (4x4 blocks). */
+    uint8_t OperatingPoint;     /* The result of choose_operating_point(), which is always 0. */
+    uint16_t OperatingPointIdc; /* operating_point_idc[OperatingPoint] */
 } OBPSequenceHeader;
 
 /*
@@ -300,6 +311,8 @@ typedef struct OBPFrameHeader {
     uint16_t render_height_minus_1;
     uint32_t RenderWidth;
     uint32_t RenderHeight;
+    uint32_t UpscaledWidth; /* For show_existing_frame, these are the size of the frame being shown. */
+    uint32_t FrameHeight;
     int allow_intrabc;
     int frame_refs_short_signaling;
     uint8_t last_frame_idx;
@@ -383,30 +396,53 @@ typedef struct OBPFrameHeader {
 
 /*
  * Tile Group OBU.
+ *
+ * TileSize and TileOffset are optional user-provided arrays with room for TileCapacity
+ * entries each, indexed by TileNum - tg_start. If set, they are filled in with the size of
+ * each tile's data, and its offset from the start of the buffer passed to obp_parse_frame or
+ * obp_parse_tile_group. Either may be NULL if not needed. TileCols * TileRows entries, from
+ * the frame header, is always enough.
  */
 typedef struct OBPTileGroup {
     uint16_t NumTiles;
     int tile_start_and_end_present_flag;
     uint16_t tg_start;
     uint16_t tg_end;
-    uint64_t TileSize[4096];
+    uint32_t *TileSize;
+    uint32_t *TileOffset;
+    size_t TileCapacity;
 } OBPTileGroup;
 
+/*
+ * A single tile_list_entry() from a Tile List OBU.
+ */
+typedef struct OBPTileListEntry {
+    uint8_t anchor_frame_idx;
+    uint8_t anchor_tile_row;
+    uint8_t anchor_tile_col;
+    uint16_t tile_data_size_minus_1;
+    uint8_t *coded_tile_data;
+    size_t coded_tile_data_size;
+} OBPTileListEntry;
+
 /*
  * Tile List OBU
+ *
+ * tile_list_entry is an optional user-provided array with room for tile_list_entry_capacity
+ * entries. If set, obp_parse_tile_list fills in every entry, which requires tile_count_minus_1 + 1
+ * entries of room. If NULL, only the header is parsed, and the entries can be read one at a time
+ * with obp_get_next_tile_list_entry.
  */
 typedef struct OBPTileList {
     uint8_t output_frame_width_in_tiles_minus_1;
     uint8_t output_frame_height_in_tiles_minus_1;
     uint16_t tile_count_minus_1;
-    struct {
-        uint8_t anchor_frame_idx;
-        uint8_t anchor_tile_row;
-        uint8_t anchor_tile_col;
-        uint16_t tile_data_size_minus_1;
-        uint8_t *coded_tile_data;
-        size_t coded_tile_data_size;
-    } tile_list_entry[65536];
+    OBPTileListEntry *tile_list_entry;
+    size_t tile_list_entry_capacity;
+
+    /* Iteration state for obp_get_next_tile_list_entry. For internal obuparse use only. */
+    size_t next_entry_pos;
+    uint32_t next_entry;
 } OBPTileList;
 
 /*
@@ -440,9 +476,9 @@ typedef struct OBPMetadata {
             int spatial_layer_description_present_flag;
             int temporal_group_description_present_flag;
             uint8_t scalability_structure_reserved_3bits;
-            uint16_t spatial_layer_max_width[3];
-            uint16_t spatial_layer_max_height[3];
-            uint8_t spatial_layer_ref_id[3];
+            uint16_t spatial_layer_max_width[4];
+            uint16_t spatial_layer_max_height[4];
+            uint8_t spatial_layer_ref_id[4];
             uint8_t temporal_group_size;
             uint8_t temporal_group_temporal_id[256];
             int temporal_group_temporal_switching_up_point_flag[256];
@@ -476,15 +512,311 @@ typedef struct OBPMetadata {
  * API structures. *
  *******************/
 
+/*
+ * Error codes set in OBPError on failure.
+ */
+typedef enum {
+    OBP_ERROR_NONE = 0,
+    OBP_ERROR_OUT_OF_DATA = 1,      /* The buffer ended before the syntax element did. */
+    OBP_ERROR_INVALID_DATA = 2,     /* A syntax element has a value the specification does not allow. */
+    OBP_ERROR_INVALID_STATE = 3,    /* The call is not valid given the state passed in. */
+    OBP_ERROR_INVALID_ARGUMENT = 4, /* A user-provided buffer or array has an unsupported size. */
+    OBP_ERROR_NOT_FOUND = 5         /* A search found nothing. */
+} OBPErrorCode;
+
 /*
  * OBPError contains a user-provided buffer and buffer size
  * where obuparse can write error messages to.
+ *
+ * On failure, code, bit_pos, and element are always set. If size is zero, no message is
+ * written at all (and error may be NULL), which avoids the cost of formatting one when
+ * failures are expected. obp_strerror can build a message from the other fields later.
  */
 typedef struct OBPError {
     char *error;
     size_t size;
+    OBPErrorCode code;
+    size_t bit_pos;      /* Position in the input buffer where parsing stopped, in bits. */
+    const char *element; /* The syntax element being read, or NULL if not applicable. */
 } OBPError;
 
+/*
+ * OBPOBUIndex describes a single OBU in a packet, as filled in by obp_index_obus.
+ * All offsets are relative to the start of the packet buffer.
+ */
+typedef struct OBPOBUIndex {
+    uint8_t obu_type; /* An OBPOBUType. */
+    uint8_t temporal_id;
+    uint8_t spatial_id;
+    uint32_t header_offset;
+    uint32_t payload_offset;
+    uint32_t size;
+} OBPOBUIndex;
+
+/*
+ * OBPByteRange describes a contiguous run of bytes in a packet, as filled in by
+ * obp_filter_operating_point. The offset is relative to the start of the packet buffer.
+ */
+typedef struct OBPByteRange {
+    uint32_t offset;
+    uint32_t size;
+} OBPByteRange;
+
+/*
+ * Groups of frame header fields, for obp_parse_frame_header_fields. They are listed in
+ * bitstream order.
+ */
+typedef enum {
+    OBP_FIELD_TILE_INFO          = 1 << 0,
+    OBP_FIELD_QUANTIZATION       = 1 << 1,
+    OBP_FIELD_SEGMENTATION       = 1 << 2,
+    OBP_FIELD_DELTA              = 1 << 3, /* delta_q_params and delta_lf_params. */
+    OBP_FIELD_LOOP_FILTER        = 1 << 4,
+    OBP_FIELD_CDEF               = 1 << 5,
+    OBP_FIELD_LOOP_RESTORATION   = 1 << 6,
+    OBP_FIELD_MODE_INFO          = 1 << 7, /* TX mode, reference_select, skip_mode_present, allow_warped_motion, and reduced_tx_set. */
+    OBP_FIELD_GLOBAL_MOTION      = 1 << 8,
+    OBP_FIELD_FILM_GRAIN         = 1 << 9,
+    OBP_FIELDS_ALL               = (1 << 10) - 1
+} OBPFrameHeaderFields;
+
+/*
+ * IVF file header, as parsed by obp_parse_ivf_header.
+ */
+typedef struct OBPIVFHeader {
+    uint16_t version;
+    uint16_t header_size;
+    uint8_t fourcc[4];
+    uint16_t width;
+    uint16_t height;
+    uint32_t timebase_den;
+    uint32_t timebase_num;
+    uint32_t num_frames;
+} OBPIVFHeader;
+
+/*
+ * AV1 codec configuration record, the payload of an ISOBMFF 'av1C' box, as parsed by
+ * obp_parse_av1c.
+ */
+typedef struct OBPAV1CodecConfig {
+    uint8_t version;
+    uint8_t seq_profile;
+    uint8_t seq_level_idx_0;
+    int seq_tier_0;
+    int high_bitdepth;
+    int twelve_bit;
+    int monochrome;
+    int chroma_subsampling_x;
+    int chroma_subsampling_y;
+    OBPChromaSamplePosition chroma_sample_position;
+    int initial_presentation_delay_present;
+    uint8_t initial_presentation_delay_minus_one;
+    size_t config_obus_offset; /* Offset of configOBUs from the start of the record. */
+    size_t config_obus_size;
+} OBPAV1CodecConfig;
+
+/*
+ * A complete OBU, as returned by obp_assembler_get_next_obu. The pointers are only valid until
+ * the next call to obp_assembler_get_next_obu or obp_assembler_push.
+ */
+typedef struct OBPAssembledOBU {
+    OBPOBUType obu_type;
+    int temporal_id;
+    int spatial_id;
+    int temporal_unit_start; /* Set for temporal delimiter OBUs, which begin a new temporal unit. */
+    uint8_t *obu;            /* The whole OBU, including its header. */
+    size_t obu_size_total;
+    uint8_t *payload;        /* The OBU payload, excluding the header. */
+    size_t obu_size;
+} OBPAssembledOBU;
+
+/*
+ * Incremental OBU assembler for input arriving in arbitrarily sized chunks.
+ *
+ * scratch is a user-provided buffer of scratch_size bytes, which must be able to hold the
+ * largest OBU that will straddle a chunk boundary. OBUs which are wholly contained in a chunk
+ * are returned in place, and only OBUs which straddle chunks are copied into scratch. The
+ * structure should be zeroed before scratch and scratch_size are set.
+ */
+typedef struct OBPAssembler {
+    uint8_t *scratch;
+    size_t scratch_size;
+
+    /* Chunk and partial OBU state. For internal obuparse use only. */
+    uint8_t *chunk;
+    size_t chunk_size;
+    size_t chunk_pos;
+    size_t scratch_fill;
+} OBPAssembler;
+
+/*
+ * Number of sequence headers kept by an OBPSequenceHeaderCache, and the largest sequence
+ * header OBU, in bytes, that it will cache. Larger ones are still parsed, but never cached.
+ */
+#define OBP_SEQUENCE_HEADER_CACHE_ENTRIES 4
+#define OBP_SEQUENCE_HEADER_CACHE_MAX_OBU_SIZE 512
+
+/*
+ * The largest possible size of a codec string, including the terminating NUL, as written
+ * by obp_get_codec_string.
+ */
+#define OBP_CODEC_STRING_MAX_SIZE 34
+
+/*
+ * Cache of recently parsed sequence headers, keyed by their raw OBU bytes, for use with
+ * obp_parse_sequence_header_cached. Must be zeroed by the user before first use. For internal
+ * obuparse use only.
+ */
+typedef struct OBPSequenceHeaderCacheEntry {
+    OBPSequenceHeader seq_header;
+    uint64_t hash;
+    uint64_t last_use;
+    size_t size;
+    int valid;
+    int cached;
+    char codec_string[OBP_CODEC_STRING_MAX_SIZE];
+    uint8_t data[OBP_SEQUENCE_HEADER_CACHE_MAX_OBU_SIZE];
+} OBPSequenceHeaderCacheEntry;
+
+typedef struct OBPSequenceHeaderCache {
+    OBPSequenceHeaderCacheEntry entries[OBP_SEQUENCE_HEADER_CACHE_ENTRIES];
+    OBPSequenceHeaderCacheEntry *current;
+    uint64_t use_count;
+} OBPSequenceHeaderCache;
+
+/*
+ * Limits from Annex A for one level and tier, as filled in by obp_level_verifier_init.
+ * Sizes are in luma samples, and rates are per second.
+ */
+typedef struct OBPLevelLimits {
+    uint32_t MaxPicSize;
+    uint32_t MaxHSize;
+    uint32_t MaxVSize;
+    uint64_t MaxDisplayRate;
+    uint64_t MaxDecodeRate;
+    uint32_t MaxHeaderRate;
+    uint64_t MaxBitrate;          /* In bits, for the tier, scaled by BitrateProfileFactor. */
+    uint32_t MinPicCompressRatio; /* MainCR or HighCR, for the tier. */
+    uint32_t MaxTiles;
+    uint32_t MaxTileCols;
+} OBPLevelLimits;
+
+/*
+ * Checks made by obp_level_verifier_push_frame, as a bitmask of the ones that failed.
+ */
+typedef enum {
+    OBP_LEVEL_PIC_SIZE          = 1 << 0, /* UpscaledWidth * FrameHeight > MaxPicSize */
+    OBP_LEVEL_H_SIZE            = 1 << 1, /* UpscaledWidth > MaxHSize */
+    OBP_LEVEL_V_SIZE            = 1 << 2, /* FrameHeight > MaxVSize */
+    OBP_LEVEL_TILES             = 1 << 3, /* TileCols * TileRows > MaxTiles */
+    OBP_LEVEL_TILE_COLS         = 1 << 4, /* TileCols > MaxTileCols */
+    OBP_LEVEL_DISPLAY_RATE      = 1 << 5, /* Shown luma samples in one second > MaxDisplayRate */
+    OBP_LEVEL_DECODE_RATE       = 1 << 6, /* Decoded luma samples in one second > MaxDecodeRate */
+    OBP_LEVEL_HEADER_RATE       = 1 << 7, /* Frame headers in one second > MaxHeaderRate */
+    OBP_LEVEL_COMPRESSION_RATIO = 1 << 8, /* Frame compressed less than MinCompressRatio */
+    OBP_LEVEL_BUFFER_UNDERFLOW  = 1 << 9  /* Frame not yet in the smoothing buffer at its removal time */
+} OBPLevelCheck;
+
+/*
+ * Number of frames kept to measure rates over a one second window. Streams with more frame
+ * headers than this in one second always fail OBP_LEVEL_HEADER_RATE.
+ */
+#define OBP_LEVEL_WINDOW_FRAMES 512
+
+/*
+ * Streaming level verifier for one operating point, as used by obp_level_verifier_init and
+ * obp_level_verifier_push_frame. It uses a fixed amount of memory regardless of stream length.
+ *
+ * The limits and results may be read by the user at any time. The rest is for internal
+ * obuparse use only.
+ */
+typedef struct OBPLevelVerifier {
+    OBPLevelLimits limits;
+    int unconstrained;            /* Set for seq_level_idx 31, which has no limits. */
+
+    /* Results so far. */
+    uint32_t violations;          /* All OBPLevelChecks which have failed for any frame. */
+    uint64_t num_frames;
+    uint64_t peak_display_rate;
+    uint64_t peak_decode_rate;
+    uint32_t peak_header_rate;
+    double min_compress_ratio;    /* Lowest CompressedRatio seen, or 0 if no frames were decoded. */
+    double min_buffer_slack;      /* Least time, in seconds, between a frame's last bit arriving and its removal. */
+
+    /* Stream parameters. */
+    uint16_t idc;
+    int operating_point;
+    uint32_t timebase_num;
+    uint32_t timebase_den;
+    uint32_t pic_size_profile_factor;
+    int still_picture;
+    int decoder_model;
+    int low_delay_mode;
+    double decoding_tick;
+    double decoder_buffer_delay;
+    double buffer_delay;
+    uint64_t buffer_removal_time_modulus;
+
+    /* One second window of frames. */
+    struct {
+        double time;
+        uint64_t decoded;
+        uint64_t displayed;
+    } window[OBP_LEVEL_WINDOW_FRAMES];
+    size_t window_start;
+    size_t window_count;
+    uint64_t window_decoded;
+    uint64_t window_displayed;
+
+    /* Smoothing buffer. */
+    int64_t first_pts;
+    int64_t last_pts;
+    double last_time;
+    double last_bit_arrival;
+    double last_removal;
+    int seen_rap;
+    double rap_removal;
+    uint64_t removal_wraps;
+    uint32_t last_buffer_removal_time;
+} OBPLevelVerifier;
+
+/*
+ * A random access point, as returned by obp_seek_index_push_frame and obp_seek_index_lookup.
+ *
+ * Decoding from offset reproduces every frame shown at or after pts. For a forward key frame,
+ * offset is that of the temporal unit holding the hidden key frame, and pts is that of the
+ * temporal unit whose show_existing_frame shows it.
+ */
+typedef struct OBPSeekPoint {
+    int64_t pts;
+    uint64_t offset;
+    int forward_key_frame;
+} OBPSeekPoint;
+
+/*
+ * Random access point tracking for obp_seek_index_push_frame. The structure should be zeroed
+ * before use. For internal obuparse use only.
+ */
+typedef struct OBPSeekIndexBuilder {
+    uint8_t pending;              /* Slots holding a hidden key frame which is not yet shown. */
+    uint64_t pending_offset[8];
+    uint64_t num_points;
+    OBPSeekPoint last_point;
+} OBPSeekIndexBuilder;
+
+/*
+ * Sizes of the seek index header and of each of its points, as written by
+ * obp_seek_index_write_header and obp_seek_index_write_point. All values are big-endian:
+ *
+ *     header: "OBPI", version (1), 3 reserved bytes, num_points (8)
+ *     point:  pts (8, two's complement), offset (8), flags (1, bit 0 is forward_key_frame)
+ *
+ * Points are sorted by pts, so lookups are a binary search over fixed size records, and
+ * need not read the whole index.
+ */
+#define OBP_SEEK_INDEX_HEADER_SIZE 16
+#define OBP_SEEK_INDEX_POINT_SIZE 17
+
 /***************************
  * Private API Structures. *
  ***************************/
@@ -493,8 +825,15 @@ typedef struct OBPError {
   * Various bits of state required for parsing uncompressed_header(), such as reference
   * management.
   *
+  * One of these is kept per stream, so it is packed: per-slot flags are bitmasks with bit i
+  * for slot i, and integers are only as wide as the specification allows. Film grain is only
+  * copied for slots where it was applied. The size is kept within OBP_STATE_SIZE_BUDGET bytes,
+  * which is checked at compile time.
+  *
   * Do not touch the values of these members. They are for internal obuparser use only.
   */
+ #define OBP_STATE_SIZE_BUDGET 5632
+
  typedef struct OBPState {
      /* Redundant Frame Header things. */
      OBPFrameHeader prev;
@@ -504,25 +843,33 @@ typedef struct OBPError {
      size_t frame_header_end_pos;
 
      /* Frame state. */
-     OBPFrameType RefFrameType[8];
-     uint8_t RefValid[8];
+     uint8_t RefFrameType[8];
+     uint8_t RefValid;
+     uint8_t RefFrameSignBias;
+     uint8_t RefApplyGrain;
      uint8_t RefOrderHint[8];
      uint8_t OrderHint[8];
-     uint8_t RefFrameId[8];
+     uint16_t RefFrameId[8];
      uint32_t RefUpscaledWidth[8];
      uint32_t RefFrameHeight[8];
      uint32_t RefRenderWidth[8];
      uint32_t RefRenderHeight[8];
-     int32_t RefFrameSignBias[8];
      OBPFilmGrainParameters RefGrainParams[8];
-     uint8_t order_hint;
-     uint32_t SavedGmParams[8][8][6];
-     int SavedFeatureEnabled[8][8][8];
+     int32_t SavedGmParams[8][7][6];
+     uint8_t SavedFeatureEnabled[8][8];
      int16_t SavedFeatureData[8][8][8];
      int8_t SavedLoopFilterRefDeltas[8][8];
      int8_t SavedLoopFilterModeDeltas[8][8];
+
+     /* Field groups which were not parsed when each slot was saved. */
+     uint16_t RefSkippedFields[8];
  } OBPState;
 
+/*
+ * The largest possible size of a serialized OBPState, as written by obp_state_serialize.
+ */
+#define OBP_STATE_SNAPSHOT_MAX_SIZE 4300
+
 /******************
  * API functions. *
  ******************/
@@ -550,6 +897,292 @@ typedef struct OBPError {
 int obp_get_next_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdiff_t *offset,
                      size_t *obu_size, int *temporal_id, int *spatial_id, OBPError *err);
 
+/*
+ * obp_index_obus parses every OBU header in a packet containing a set of one or more OBUs
+ * (e.g. an IVF or ISOBMFF packet) in a single call, and fills a user-provided array with
+ * the location and header data of each one, in bitstream order.
+ *
+ * Input:
+ *     buf        - Input packet buffer. Must be smaller than 4 GiB.
+ *     buf_size   - Size of the input packet buffer.
+ *     index_size - Number of entries available in the index array.
+ *     err        - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     index    - A user provided array that will be filled in with one entry per OBU.
+ *     num_obus - The number of entries filled in. On error, this is the number of OBUs
+ *                successfully indexed before the error.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if the packet contains more than index_size OBUs.
+ */
+int obp_index_obus(uint8_t *buf, size_t buf_size, OBPOBUIndex *index, size_t index_size,
+                   size_t *num_obus, OBPError *err);
+
+/*
+ * obp_filter_operating_point selects the OBUs in a packet which belong to an operating point,
+ * following the drop rules in the OBU semantics, and returns them as a list of byte ranges
+ * which can be passed straight to a scatter/gather write (e.g. writev). No data is copied,
+ * and only OBU headers are read; payloads are never parsed.
+ *
+ * An OBU is dropped if it has an extension header, is neither a sequence header nor a
+ * temporal delimiter, and its temporal_id or spatial_id is not in operating_point_idc.
+ * Adjacent kept OBUs are merged into a single range. If operating_point_idc is 0, the
+ * whole packet is kept.
+ *
+ * Input:
+ *     buf                 - Input packet buffer. Must be smaller than 4 GiB.
+ *     buf_size            - Size of the input packet buffer.
+ *     operating_point_idc - The operating_point_idc of the chosen operating point, e.g.
+ *                           seq_header->operating_point_idc[op].
+ *     ranges_size         - Number of entries available in the ranges array.
+ *     err                 - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     ranges     - A user provided array that will be filled in with the byte ranges to keep,
+ *                  in bitstream order.
+ *     num_ranges - The number of entries filled in. May be zero if every OBU was dropped.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if more than ranges_size ranges are needed.
+ */
+int obp_filter_operating_point(uint8_t *buf, size_t buf_size, uint16_t operating_point_idc,
+                               OBPByteRange *ranges, size_t ranges_size, size_t *num_ranges,
+                               OBPError *err);
+
+/*
+ * obp_find_temporal_delimiter scans a buffer of concatenated OBUs (e.g. a damaged stream, or
+ * one without container framing) for the next temporal delimiter OBU, so that parsing can be
+ * resynchronized from there. Only temporal delimiters written with a size field and no
+ * extension header (the bytes 0x12 0x00) are found.
+ *
+ * Each candidate is verified by parsing the OBU headers that follow it. Candidates which fail
+ * verification are skipped.
+ *
+ * Input:
+ *     buf        - Input buffer.
+ *     buf_size   - Size of the input buffer.
+ *     num_verify - Number of OBUs after the temporal delimiter which must have valid headers
+ *                  and sizes. Fewer are checked if the buffer ends on an OBU boundary first,
+ *                  but never fewer than one, unless num_verify is zero.
+ *     err        - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     offset - The offset into the buffer where the temporal delimiter OBU header starts.
+ *
+ * Returns:
+ *     0 on success, -1 if no valid temporal delimiter was found. If the buffer ends right
+ *     after a temporal delimiter, so that nothing after it can be verified, the error code
+ *     is OBP_ERROR_OUT_OF_DATA, and more data should be appended before trying again.
+ */
+int obp_find_temporal_delimiter(uint8_t *buf, size_t buf_size, int num_verify, ptrdiff_t *offset, OBPError *err);
+
+/*
+ * obp_get_next_annexb_temporal_unit, obp_get_next_annexb_frame_unit, and obp_get_next_annexb_obu
+ * walk a bitstream using the length delimited format from Annex B of the AV1 specification,
+ * without copying or rewriting it.
+ *
+ * A buffer of concatenated temporal units is walked with obp_get_next_annexb_temporal_unit.
+ * Each temporal unit's data is in turn walked with obp_get_next_annexb_frame_unit, and each
+ * frame unit's data with obp_get_next_annexb_obu. At every level, the next unit starts at
+ * offset + size, and the walk of a unit is complete when exactly its size has been consumed.
+ *
+ * obp_get_next_annexb_obu reads obu_length and then the OBU header, and otherwise behaves the
+ * same as obp_get_next_obu. The OBU may or may not have its own size field.
+ *
+ * Input:
+ *     buf      - Input buffer, starting at the unit's size field.
+ *     buf_size - Size of the input buffer, which must not extend past the enclosing unit.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     offset             - The offset into the buffer where the unit's data starts. For OBUs,
+ *                          this excludes obu_length and the OBU header.
+ *     temporal_unit_size - The size of the temporal unit's data.
+ *     frame_unit_size    - The size of the frame unit's data.
+ *     obu_type, obu_size, temporal_id, spatial_id - As in obp_get_next_obu.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_get_next_annexb_temporal_unit(uint8_t *buf, size_t buf_size, ptrdiff_t *offset, size_t *temporal_unit_size,
+                                      OBPError *err);
+int obp_get_next_annexb_frame_unit(uint8_t *buf, size_t buf_size, ptrdiff_t *offset, size_t *frame_unit_size,
+                                   OBPError *err);
+int obp_get_next_annexb_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdiff_t *offset,
+                            size_t *obu_size, int *temporal_id, int *spatial_id, OBPError *err);
+
+/*
+ * obp_assembler_push hands the next chunk of a stream of low overhead bitstream format OBUs to
+ * an assembler. The previous chunk must have been fully consumed, i.e. obp_assembler_get_next_obu
+ * must have returned 0. The chunk is not copied, and must stay valid until then.
+ *
+ * Input:
+ *     assembler - The assembler to push data into.
+ *     buf       - Input chunk buffer. May start and end anywhere within an OBU.
+ *     buf_size  - Size of the input chunk buffer.
+ *     err       - An error buffer and buffer size to write any error messages into.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_assembler_push(OBPAssembler *assembler, uint8_t *buf, size_t buf_size, OBPError *err);
+
+/*
+ * obp_assembler_get_next_obu returns the next complete OBU from the data pushed into an
+ * assembler. Callers should call it until it returns 0, and then push the next chunk.
+ *
+ * Temporal units are delimited by OBUs with temporal_unit_start set, rather than returned
+ * whole, so that nothing needs to be retained or copied beyond straddling OBUs. The OBUs must
+ * have size fields, as is required outside of Annex B and container formats.
+ *
+ * Input:
+ *     assembler - The assembler to read from.
+ *     err       - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     obu - A user provided structure that will be filled in with the location and header
+ *           data of the OBU.
+ *
+ * Returns:
+ *     1 if an OBU was returned, 0 if more data needs to be pushed, -1 on error.
+ */
+int obp_assembler_get_next_obu(OBPAssembler *assembler, OBPAssembledOBU *obu, OBPError *err);
+
+/*
+ * obp_parse_ivf_header parses and validates the file header at the start of an IVF file. Only
+ * version 0 files with an 'AV01' FourCC are accepted.
+ *
+ * Input:
+ *     buf      - Input buffer, starting at the beginning of the file.
+ *     buf_size - Size of the input buffer. Must be at least 32 bytes.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     ivf_header - A user provided structure that will be filled in with the parsed data. The
+ *                  first frame header starts at header_size bytes into the file.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_parse_ivf_header(uint8_t *buf, size_t buf_size, OBPIVFHeader *ivf_header, OBPError *err);
+
+/*
+ * obp_get_next_ivf_frame parses the IVF frame header at the start of a buffer, and returns
+ * the location of the frame's data, without copying it. The next frame header starts at
+ * offset + frame_size.
+ *
+ * Input:
+ *     buf      - Input buffer, starting at an IVF frame header.
+ *     buf_size - Size of the input buffer.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     offset     - The offset into the buffer where the frame data starts.
+ *     frame_size - The size of the frame data.
+ *     pts        - The presentation timestamp of the frame, in the file's timebase.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if the frame is truncated.
+ */
+int obp_get_next_ivf_frame(uint8_t *buf, size_t buf_size, ptrdiff_t *offset, size_t *frame_size,
+                           int64_t *pts, OBPError *err);
+
+/*
+ * obp_get_next_mp4_box parses the ISOBMFF box header at the start of a buffer, and returns
+ * the location of the box's payload, without copying it. Both 32-bit and 64-bit box sizes
+ * are supported, and a box size of zero extends to the end of the buffer. The next box
+ * starts at offset + payload_size.
+ *
+ * For 'uuid' boxes, the payload starts with the 16 byte extended type.
+ *
+ * Input:
+ *     buf      - Input buffer, starting at a box header.
+ *     buf_size - Size of the input buffer.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     box_type     - The four character box type.
+ *     offset       - The offset into the buffer where the box payload starts.
+ *     payload_size - The size of the box payload.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if the box is truncated.
+ */
+int obp_get_next_mp4_box(uint8_t *buf, size_t buf_size, uint8_t box_type[4], ptrdiff_t *offset,
+                         size_t *payload_size, OBPError *err);
+
+/*
+ * obp_parse_av1c parses an AV1 codec configuration record, as found in the payload of an
+ * ISOBMFF 'av1C' box, and optionally parses the sequence header OBU in its configOBUs.
+ *
+ * Input:
+ *     buf      - Input buffer, starting at the beginning of the record.
+ *     buf_size - Size of the input buffer. Must be at least 4 bytes.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     config             - A user provided structure that will be filled in with the parsed data.
+ *     seq_header         - A user provided structure that will be zeroed and filled in with the
+ *                          first sequence header OBU in configOBUs, if there is one. May be NULL,
+ *                          in which case configOBUs is not parsed.
+ *     seq_header_present - Set to 1 if a sequence header OBU was found and parsed into seq_header,
+ *                          and 0 otherwise. May be NULL if seq_header is NULL.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_parse_av1c(uint8_t *buf, size_t buf_size, OBPAV1CodecConfig *config, OBPSequenceHeader *seq_header,
+                   int *seq_header_present, OBPError *err);
+
+/*
+ * obp_write_av1c writes the AV1 codec configuration record for a sequence, as carried in the
+ * payload of an ISOBMFF 'av1C' box, from an already parsed sequence header and the sequence
+ * header OBU it was parsed from. The OBU is copied into configOBUs as is, except that it is
+ * always written with a size field, as configOBUs requires.
+ *
+ * Input:
+ *     seq_header          - The parsed sequence header.
+ *     seq_header_obu      - The whole sequence header OBU, including its OBU header.
+ *     seq_header_obu_size - Size of the sequence header OBU.
+ *     buf_size            - Size of the output buffer.
+ *     err                 - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     buf  - A user provided buffer that the record will be written to.
+ *     size - The size of the record. If buf is too small, this is set to the required size, and
+ *            nothing is written.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if buf is too small.
+ */
+int obp_write_av1c(OBPSequenceHeader *seq_header, uint8_t *seq_header_obu, size_t seq_header_obu_size,
+                   uint8_t *buf, size_t buf_size, size_t *size, OBPError *err);
+
+/*
+ * obp_write_av01_sample_entry writes a whole ISOBMFF 'av01' visual sample entry box for a
+ * sequence, for use in an 'stsd' box. Its width and height are the maximum frame size, and it
+ * contains an 'av1C' box, as written by obp_write_av1c, followed by an 'nclx' type 'colr' box
+ * if the sequence header signals a color description.
+ *
+ * Input:
+ *     seq_header          - The parsed sequence header.
+ *     seq_header_obu      - The whole sequence header OBU, including its OBU header.
+ *     seq_header_obu_size - Size of the sequence header OBU.
+ *     buf_size            - Size of the output buffer.
+ *     err                 - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     buf  - A user provided buffer that the box will be written to.
+ *     size - The size of the box. If buf is too small, this is set to the required size, and
+ *            nothing is written.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if buf is too small.
+ */
+int obp_write_av01_sample_entry(OBPSequenceHeader *seq_header, uint8_t *seq_header_obu, size_t seq_header_obu_size,
+                                uint8_t *buf, size_t buf_size, size_t *size, OBPError *err);
+
 /*
  * obp_parse_sequence_header parses a sequence header OBU and fills out the fields in a
  * user-provided OBPSequenceHeader structure.
@@ -567,6 +1200,70 @@ int obp_get_next_obu(uint8_t *buf, size_t buf_size, OBPOBUType *obu_type, ptrdif
  */
 int obp_parse_sequence_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq_header, OBPError *err);
 
+/*
+ * obp_parse_sequence_header_cached is the same as obp_parse_sequence_header, but first looks up
+ * the raw OBU bytes in a cache of recently parsed sequence headers, and only parses them if
+ * they are not found. Streams usually repeat an identical sequence header on every key frame,
+ * so most calls are a hash and a memcmp.
+ *
+ * It also reports whether the sequence header differs from the one returned by the previous
+ * call on the same cache, e.g. on a resolution or profile switch. Two headers which only differ
+ * in their raw bytes, but parse to the same values, are not considered different.
+ *
+ * Input:
+ *     buf      - Input OBU buffer. This is expected to *NOT* contain the OBU header.
+ *     buf_size - Size of the input OBU buffer.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     cache      - A user provided cache, which must be zeroed before first use.
+ *     seq_header - A pointer to the parsed sequence header, owned by 'cache'. Only valid until the
+ *                  next call on the same cache.
+ *     changed    - Set to 1 if the sequence header differs from the previous one, including on
+ *                  the first call, or 0 if not.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_parse_sequence_header_cached(uint8_t *buf, size_t buf_size, OBPSequenceHeaderCache *cache,
+                                     OBPSequenceHeader **seq_header, int *changed, OBPError *err);
+
+/*
+ * obp_get_codec_string writes the codecs parameter string for a sequence, as used by MSE
+ * and RFC 6381 (e.g. in DASH and HLS manifests), in the form av01.P.LLT.DD.M.CCC.cp.tc.mc.F.
+ * The optional fields are always included.
+ *
+ * Input:
+ *     seq_header - The parsed sequence header.
+ *     buf_size   - Size of the output buffer. OBP_CODEC_STRING_MAX_SIZE bytes is always enough.
+ *     err        - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     buf - A user provided buffer that the NUL terminated codec string will be written to.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if buf is too small.
+ */
+int obp_get_codec_string(OBPSequenceHeader *seq_header, char *buf, size_t buf_size, OBPError *err);
+
+/*
+ * obp_get_codec_string_cached returns the codec string for the sequence header most recently
+ * returned by obp_parse_sequence_header_cached. It is built once per cache entry, so repeated
+ * sequence headers cost neither a parse nor a formatting pass.
+ *
+ * Input:
+ *     cache - The cache passed to obp_parse_sequence_header_cached.
+ *     err   - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     codec_string - Set to point to the NUL terminated codec string, which is owned by the cache
+ *                    and valid until the next call to obp_parse_sequence_header_cached.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if no sequence header has been parsed yet.
+ */
+int obp_get_codec_string_cached(OBPSequenceHeaderCache *cache, const char **codec_string, OBPError *err);
+
 /*
  * obp_parse_frame_header parses a frame header OBU and fills out the fields in a user-provided
  * OBPFrameHeader structure.
@@ -589,6 +1286,69 @@ int obp_parse_sequence_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *
 int obp_parse_frame_header(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq_header, OBPState *state,
                            int temporal_id, int spatial_id, OBPFrameHeader *frame_header, int *SeenFrameHeader, OBPError *err);
 
+/*
+ * obp_parse_frame_header_fields is the same as obp_parse_frame_header, but only parses as far
+ * into the frame header as is needed for the requested field groups.
+ *
+ * Everything up to tile_info(), e.g. frame_type, show_frame, order_hint, refresh_frame_flags,
+ * the frame size, and the reference frame indices, is always parsed, so passing 0 is enough
+ * to track GOP structure. Groups which come before a requested group in the bitstream are
+ * also parsed, since the parser has to read through them to reach it. Fields of groups which
+ * are not parsed are left untouched.
+ *
+ * If not all groups are parsed:
+ *     - The reference state in 'state' for the unparsed groups (segmentation, loop filter
+ *       deltas, global motion, and film grain) is not valid, so the same set of fields
+ *       should be used for the whole stream. A later parse which needs one of these groups
+ *       from a reference slot saved without it fails with OBP_ERROR_INVALID_STATE, until
+ *       that slot is refreshed by a parse which includes it.
+ *     - SeenFrameHeader is left at zero, and redundant frame header OBUs are parsed like
+ *       any other frame header. Since they only repeat their frame header, they can simply
+ *       be skipped.
+ *     - The end of the frame header is not known, so the tile group in a frame OBU cannot
+ *       be located.
+ *
+ * Input:
+ *     fields - A mask of OBPFrameHeaderFields values.
+ *     All others are the same as obp_parse_frame_header.
+ *
+ * Output:
+ *     Same as obp_parse_frame_header.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_parse_frame_header_fields(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq_header, OBPState *state,
+                                  int temporal_id, int spatial_id, uint32_t fields, OBPFrameHeader *frame_header,
+                                  int *SeenFrameHeader, OBPError *err);
+
+/*
+ * obp_parse_frame_header_ref is the same as obp_parse_frame_header, but instead of filling out a
+ * user-provided structure, it parses directly into the copy kept in 'state' for redundant frame
+ * headers, and returns a pointer to it. This avoids copying the frame header in and out of 'state'.
+ *
+ * The returned frame header is only valid until the next call to any of the frame header or frame
+ * parsing functions with the same 'state'. If the header is needed for longer, copy it.
+ *
+ * Input:
+ *     buf          - Input OBU buffer. This is expected to *NOT* contain the OBU header.
+ *     buf_size     - Size of the input OBU buffer.
+ *     state        - An opaque state structure. Must be zeroed by the user on first use.
+ *     temporal_id  - A temporal ID previously obtained from obu_parse_sequence header.
+ *     spatial_id   - A spatial ID previously obtained from obu_parse_sequence header.
+ *     err          - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     frame_header    - A pointer to the parsed frame header, owned by 'state'.
+ *     SeenFrameHeader - Whether or not a frame header has been seen. Tracking variable as per AV1 spec.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_parse_frame_header_ref(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq_header, OBPState *state,
+                               int temporal_id, int spatial_id, const OBPFrameHeader **frame_header,
+                               int *SeenFrameHeader, OBPError *err);
+
 /*
  * obp_parse_frame parses a frame OBU and fills out the fields in user-provided OBPFrameHeader
  * and OBPTileGroup structures.
@@ -613,6 +1373,36 @@ int obp_parse_frame(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq_header
                     int temporal_id, int spatial_id, OBPFrameHeader *frame_header, OBPTileGroup *tile_group,
                     int *SeenFrameHeader, OBPError *err);
 
+/*
+ * obp_parse_frame_ref is the same as obp_parse_frame, but returns the frame header the same
+ * way as obp_parse_frame_header_ref does, with the same lifetime.
+ */
+int obp_parse_frame_ref(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq_header, OBPState *state,
+                        int temporal_id, int spatial_id, const OBPFrameHeader **frame_header, OBPTileGroup *tile_group,
+                        int *SeenFrameHeader, OBPError *err);
+
+/*
+ * obp_parse_frame_no_tiles is the same as obp_parse_frame, but does not walk the tile sizes
+ * in the frame OBU's tile group. Only the tile group's start and end are read, to keep
+ * SeenFrameHeader up to date. The tile group's location is returned instead, so that it may
+ * be passed to obp_parse_tile_group later, if needed.
+ *
+ * Input:
+ *     Same as obp_parse_frame.
+ *
+ * Output:
+ *     frame_header      - A user provided structure that will be filled in with all the parsed data.
+ *     tile_group_offset - The offset into the buffer where the tile group starts.
+ *     tile_group_size   - The size of the tile group.
+ *     SeenFrameHeader   - Whether or not a frame header has been seen. Tracking variable as per AV1 spec.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_parse_frame_no_tiles(uint8_t *buf, size_t buf_size, OBPSequenceHeader *seq_header, OBPState *state,
+                             int temporal_id, int spatial_id, OBPFrameHeader *frame_header, size_t *tile_group_offset,
+                             size_t *tile_group_size, int *SeenFrameHeader, OBPError *err);
+
 /*
  * obp_parse_tile_group parses a tile group OBU and fills out the fields in a
  * user-provided OBPTileGroup structure.
@@ -669,4 +1459,254 @@ int obp_parse_metadata(uint8_t *buf, size_t buf_size, OBPMetadata *metadata, OBP
  */
 int obp_parse_tile_list(uint8_t *buf, size_t buf_size, OBPTileList *tile_list, OBPError *err);
 
+/*
+ * obp_get_next_tile_list_entry parses the next tile_list_entry() of a tile list OBU whose header
+ * was previously parsed with obp_parse_tile_list, so that entries can be processed one at a time
+ * without storing them all. It may be called tile_count_minus_1 + 1 times after each call to
+ * obp_parse_tile_list. The returned entry is *NOT* safe to use once the user-provided 'buf' has
+ * been freed, since its coded_tile_data points into that data.
+ *
+ * Input:
+ *     buf       - Input OBU buffer. Must be the same one passed to obp_parse_tile_list.
+ *     buf_size  - Size of the input OBU buffer.
+ *     tile_list - A tile list previously filled in by obp_parse_tile_list. Its iteration state
+ *                 is updated.
+ *     err       - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     entry - A user provided structure that will be filled in with the next entry.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if all entries have already been read.
+ */
+int obp_get_next_tile_list_entry(uint8_t *buf, size_t buf_size, OBPTileList *tile_list, OBPTileListEntry *entry,
+                                 OBPError *err);
+
+/*
+ * obp_state_serialize writes the reference state kept in an OBPState into a compact, portable
+ * snapshot, which obp_state_deserialize can later restore, possibly in another process. This
+ * allows parsing to resume from a checkpoint, such as a key frame, instead of from the start of
+ * the stream.
+ *
+ * Snapshots should only be taken between temporal units, or at least when SeenFrameHeader is
+ * zero, since the copy of the last frame header kept for redundant frame headers is not saved.
+ *
+ * Input:
+ *     state    - The state to serialize.
+ *     buf_size - Size of the output buffer. Must be at least OBP_STATE_SNAPSHOT_MAX_SIZE.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     buf  - A user provided buffer that the snapshot will be written to.
+ *     size - The number of bytes written.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_state_serialize(OBPState *state, uint8_t *buf, size_t buf_size, size_t *size, OBPError *err);
+
+/*
+ * obp_state_deserialize restores an OBPState from a snapshot written by obp_state_serialize.
+ *
+ * Input:
+ *     buf      - Input snapshot buffer.
+ *     buf_size - Size of the input snapshot buffer.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     state - A user provided structure that will be overwritten with the restored state.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_state_deserialize(uint8_t *buf, size_t buf_size, OBPState *state, OBPError *err);
+
+/*
+ * obp_level_verifier_init sets up a verifier which checks that the frames of one operating
+ * point stay within the Annex A limits for its seq_level_idx and seq_tier. If the sequence
+ * header changes, the verifier must be set up again.
+ *
+ * Rates are measured over a sliding one second window of frame timestamps.
+ *
+ * Bitrate is checked with a smoothing buffer filled at MaxBitrate. Each frame's bits may
+ * start arriving no earlier than decoder_buffer_delay + encoder_buffer_delay before its
+ * removal time, and must all have arrived by then. Without a decoder model for the
+ * operating point, the Annex C defaults of 70000 and 20000 (in 1/90000 seconds) are used.
+ * Removal times advance with the frame's timestamp from an initial decoder_buffer_delay.
+ * Once a shown key frame which signals buffer_removal_time has been seen, its removal time
+ * anchors the decoder model: when the operating point has one, later frames which signal
+ * buffer_removal_time are removed that long after the most recent such key frame, which in
+ * turn becomes the new anchor. Frames before the first anchor, including any leading frames
+ * of a stream which does not start on a key frame, keep using their timestamps. A
+ * buffer_removal_time which does not increase from the previous frame's is taken to have
+ * wrapped around. Underflow is not checked for operating points in low delay mode.
+ *
+ * Each decoded frame's CompressedRatio must be at least Max(0.8, MinPicCompressRatio *
+ * SpeedAdj), where SpeedAdj is the decode rate over the current window divided by
+ * MaxDecodeRate, or exactly 0.8 for still pictures.
+ *
+ * Input:
+ *     seq_header      - The sequence header for the frames to be verified.
+ *     operating_point - The operating point to verify, and whose level and tier apply.
+ *     timebase_num    - Numerator of the timebase of the timestamps which will be passed in.
+ *     timebase_den    - Denominator of the timebase of the timestamps which will be passed in.
+ *     err             - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     verifier - A user provided structure that will be initialized.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if seq_level_idx is reserved.
+ */
+int obp_level_verifier_init(OBPLevelVerifier *verifier, OBPSequenceHeader *seq_header, int operating_point,
+                            uint32_t timebase_num, uint32_t timebase_den, OBPError *err);
+
+/*
+ * obp_level_verifier_push_frame checks a frame against the verifier's limits, and adds it to
+ * the rate measurements. It should be called for every frame header, including those with
+ * show_existing_frame set, but not for redundant frame headers. Frames outside the operating
+ * point are ignored.
+ *
+ * Input:
+ *     verifier     - A verifier set up by obp_level_verifier_init.
+ *     frame_header - The parsed frame header.
+ *     temporal_id  - The temporal ID of the frame's OBUs.
+ *     spatial_id   - The spatial ID of the frame's OBUs.
+ *     pts          - The timestamp of the frame's temporal unit. Must not decrease.
+ *     coded_size   - Size in bytes of all OBUs since the previous frame, up to and including
+ *                    this frame's last tile group (e.g. temporal delimiters, sequence headers,
+ *                    the frame header, and tile groups).
+ *     err          - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     violations - The OBPLevelChecks which failed for this frame. They are also added to
+ *                  verifier->violations.
+ *
+ * Returns:
+ *     0 on success, -1 on error. Failed checks are not errors.
+ */
+int obp_level_verifier_push_frame(OBPLevelVerifier *verifier, OBPFrameHeader *frame_header, int temporal_id,
+                                  int spatial_id, int64_t pts, size_t coded_size, uint32_t *violations,
+                                  OBPError *err);
+
+/*
+ * obp_seek_index_push_frame tracks random access points in decode order. It should be called
+ * for every frame header, including those with show_existing_frame set, but not for redundant
+ * frame headers.
+ *
+ * A shown key frame in a temporal unit which carries a sequence header is a random access
+ * point. So is a show_existing_frame of a hidden key frame, a forward key frame, whose own
+ * temporal unit carried a sequence header, as long as its slot was not refreshed in between.
+ * Each temporal unit yields at most one point.
+ *
+ * Input:
+ *     builder        - A zeroed builder, or one used for the previous frames of the stream.
+ *     frame_header   - The parsed frame header.
+ *     pts            - The timestamp of the frame's temporal unit.
+ *     offset         - The position of the frame's temporal unit, e.g. in the file.
+ *     has_seq_header - Whether the frame's temporal unit carries a sequence header.
+ *     err            - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     point     - Filled in with the new random access point, if there is one.
+ *     has_point - Set to 1 if this frame completed a new random access point, 0 otherwise.
+ *
+ * Returns:
+ *     0 on success, -1 on error, including if a point's pts is lower than that of the
+ *     previous point, since the index could not be searched.
+ */
+int obp_seek_index_push_frame(OBPSeekIndexBuilder *builder, OBPFrameHeader *frame_header, int64_t pts,
+                              uint64_t offset, int has_seq_header, OBPSeekPoint *point, int *has_point,
+                              OBPError *err);
+
+/*
+ * obp_seek_index_write_header writes a seek index header. Since the number of points is
+ * usually only known at the end, it may be written again once all points are written.
+ *
+ * Input:
+ *     num_points - The number of points which follow the header.
+ *     buf_size   - Size of the output buffer. Must be at least OBP_SEEK_INDEX_HEADER_SIZE.
+ *     err        - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     buf - A user provided buffer that the header will be written to.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_seek_index_write_header(uint64_t num_points, uint8_t *buf, size_t buf_size, OBPError *err);
+
+/*
+ * obp_seek_index_write_point writes a single seek index point.
+ *
+ * Input:
+ *     point    - The point to write.
+ *     buf_size - Size of the output buffer. Must be at least OBP_SEEK_INDEX_POINT_SIZE.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     buf - A user provided buffer that the point will be written to.
+ *
+ * Returns:
+ *     0 on success, -1 on error.
+ */
+int obp_seek_index_write_point(OBPSeekPoint *point, uint8_t *buf, size_t buf_size, OBPError *err);
+
+/*
+ * obp_seek_index_get_point reads the point at the given index out of a complete seek index,
+ * after checking its header.
+ *
+ * Input:
+ *     buf      - Input seek index buffer, starting with its header.
+ *     buf_size - Size of the input seek index buffer.
+ *     index    - Which point to read.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     num_points - The number of points in the index. May be NULL.
+ *     point      - A user provided structure that will be filled in with the point.
+ *
+ * Returns:
+ *     0 on success, -1 on error. If index is past the last point, the error code is
+ *     OBP_ERROR_NOT_FOUND.
+ */
+int obp_seek_index_get_point(uint8_t *buf, size_t buf_size, uint64_t index, uint64_t *num_points,
+                             OBPSeekPoint *point, OBPError *err);
+
+/*
+ * obp_seek_index_lookup finds the random access point to start decoding from to show the
+ * frame at the given pts, i.e. the last point whose pts is not greater than it, with a
+ * binary search of a complete seek index.
+ *
+ * Input:
+ *     buf      - Input seek index buffer, starting with its header.
+ *     buf_size - Size of the input seek index buffer.
+ *     pts      - The timestamp to seek to.
+ *     err      - An error buffer and buffer size to write any error messages into.
+ *
+ * Output:
+ *     index - The index of the point found. May be NULL.
+ *     point - A user provided structure that will be filled in with the point found.
+ *
+ * Returns:
+ *     0 on success, -1 on error. If pts is before the first point, the error code is
+ *     OBP_ERROR_NOT_FOUND.
+ */
+int obp_seek_index_lookup(uint8_t *buf, size_t buf_size, int64_t pts, uint64_t *index, OBPSeekPoint *point,
+                          OBPError *err);
+
+/*
+ * obp_strerror writes a message describing an error previously returned by any obuparse
+ * function into a user-provided buffer. This is useful if the error was returned with
+ * no message buffer provided.
+ *
+ * Input:
+ *     err  - An error filled in by a failed obuparse call.
+ *     size - Size of the output buffer.
+ *
+ * Output:
+ *     buf - A user provided buffer that the message will be written to.
+ */
+void obp_strerror(const OBPError *err, char *buf, size_t size);
+
 #endif
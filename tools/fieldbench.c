@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Benchmark for obp_parse_frame_header_fields, comparing parsing every field
+ * against the "GOP structure only" field set, over every frame header in an
+ * IVF file. The GOP structure fields are checked to match between the two.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "obuparse.h"
+#include "tools/ivf.h"
+
+#define ITERATIONS 100
+
+static int parse_file(IVFReader *ivf, uint32_t fields, uint64_t *checksum, int *num_frames)
+{
+    static OBPState state;
+    OBPSequenceHeader hdr = { 0 };
+    int seen_seq          = 0;
+    int SeenFrameHeader   = 0;
+    char err_buf[1024];
+    OBPError err          = { &err_buf[0], 1024, OBP_ERROR_NONE, 0, NULL };
+
+    memset(&state, 0, sizeof(state));
+    ivf->pos     = ivf->header.header_size;
+    *checksum    = 0;
+    *num_frames  = 0;
+
+    while (1) {
+        uint8_t *packet_buf;
+        size_t packet_size;
+        size_t packet_pos = 0;
+        int64_t pts;
+        uint64_t file_offset;
+        int ret;
+
+        ret = ivf_read_frame(ivf, &packet_buf, &packet_size, &pts, &file_offset, &err);
+        if (ret == 1)
+            break;
+        if (ret < 0) {
+            printf("Failed to read in IVF frame: %s\n", err.error);
+            return -1;
+        }
+
+        while (packet_pos < packet_size) {
+            ptrdiff_t offset;
+            size_t obu_size;
+            int temporal_id, spatial_id;
+            OBPOBUType obu_type;
+            OBPFrameHeader frame_hdr;
+            uint8_t *obu;
+
+            if (obp_get_next_obu(packet_buf + packet_pos, packet_size - packet_pos, &obu_type, &offset,
+                                 &obu_size, &temporal_id, &spatial_id, &err) < 0) {
+                printf("Failed to parse OBU header: %s\n", err.error);
+                return -1;
+            }
+
+            obu = packet_buf + packet_pos + offset;
+
+            if (obu_type == OBP_OBU_TEMPORAL_DELIMITER) {
+                SeenFrameHeader = 0;
+            } else if (obu_type == OBP_OBU_SEQUENCE_HEADER) {
+                memset(&hdr, 0, sizeof(hdr));
+                if (obp_parse_sequence_header(obu, obu_size, &hdr, &err) < 0) {
+                    printf("Failed to parse sequence header: %s\n", err.error);
+                    return -1;
+                }
+                seen_seq = 1;
+            } else if (seen_seq && (obu_type == OBP_OBU_FRAME || obu_type == OBP_OBU_FRAME_HEADER)) {
+                memset(&frame_hdr, 0, sizeof(frame_hdr));
+                if (obp_parse_frame_header_fields(obu, obu_size, &hdr, &state, temporal_id, spatial_id, fields,
+                                                  &frame_hdr, &SeenFrameHeader, &err) < 0) {
+                    printf("Failed to parse frame header: %s\n", err.error);
+                    return -1;
+                }
+                /* The tile group isn't parsed, so treat each frame OBU as ending its frame. */
+                if (obu_type == OBP_OBU_FRAME)
+                    SeenFrameHeader = 0;
+
+                *checksum = *checksum * 31 + (uint64_t) frame_hdr.frame_type;
+                *checksum = *checksum * 31 + (uint64_t) frame_hdr.show_existing_frame;
+                *checksum = *checksum * 31 + (uint64_t) frame_hdr.show_frame;
+                *checksum = *checksum * 31 + frame_hdr.order_hint;
+                *checksum = *checksum * 31 + frame_hdr.refresh_frame_flags;
+                *checksum = *checksum * 31 + frame_hdr.RenderWidth;
+                *checksum = *checksum * 31 + frame_hdr.RenderHeight;
+                for (int i = 0; i < 7; i++)
+                    *checksum = *checksum * 31 + frame_hdr.ref_frame_idx[i];
+                (*num_frames)++;
+            }
+
+            packet_pos += obu_size + (size_t) offset;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    IVFReader ivf;
+    char err_buf[1024];
+    OBPError err         = { &err_buf[0], 1024, OBP_ERROR_NONE, 0, NULL };
+    uint32_t fields[2]   = { OBP_FIELDS_ALL, 0 };
+    uint64_t checksum[2] = { 0, 0 };
+    double elapsed[2]    = { -1.0, -1.0 };
+    int num_frames       = 0;
+
+    if (argc < 2) {
+        printf("Usage: %s file.ivf\n", argv[0]);
+        return 1;
+    }
+
+    if (ivf_open(&ivf, argv[1], &err) < 0) {
+        printf("Failed to open IVF file: %s\n", err.error);
+        return 1;
+    }
+
+    /* Alternate between field sets, and keep the best run of each. */
+    for (int run = 0; run < 6; run++) {
+        int set       = run & 1;
+        clock_t start = clock();
+        double time;
+        for (int it = 0; it < ITERATIONS; it++) {
+            if (parse_file(&ivf, fields[set], &checksum[set], &num_frames) < 0) {
+                ivf_close(&ivf);
+                return 1;
+            }
+        }
+        time = ((double) (clock() - start)) / CLOCKS_PER_SEC;
+        if (elapsed[set] < 0.0 || time < elapsed[set])
+            elapsed[set] = time;
+    }
+
+    ivf_close(&ivf);
+
+    printf("{\"frames\": %d, \"all_fields_ns\": %.1f, \"gop_fields_ns\": %.1f, \"checksums_match\": %s}\n",
+           num_frames, elapsed[0] * 1e9 / ((double) num_frames * ITERATIONS),
+           elapsed[1] * 1e9 / ((double) num_frames * ITERATIONS), checksum[0] == checksum[1] ? "true" : "false");
+
+    return 0;
+}
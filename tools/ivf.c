@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "obuparse.h"
+#include "tools/ivf.h"
+#include "tools/map.h"
+
+int ivf_open(IVFReader *ivf, const char *path, OBPError *err)
+{
+    memset(ivf, 0, sizeof(*ivf));
+
+    if (map_open(&ivf->map, path, err) < 0)
+        return -1;
+
+    if (obp_parse_ivf_header(ivf->map.buf, (size_t) ivf->map.size, &ivf->header, err) < 0) {
+        ivf_close(ivf);
+        return -1;
+    }
+
+    ivf->pos = ivf->header.header_size;
+    map_readahead(&ivf->map, ivf->pos);
+
+    return 0;
+}
+
+int ivf_read_frame(IVFReader *ivf, uint8_t **frame, size_t *frame_size, int64_t *pts, uint64_t *file_offset,
+                   OBPError *err)
+{
+    ptrdiff_t offset;
+
+    if (ivf->pos >= ivf->map.size)
+        return 1;
+
+    if (obp_get_next_ivf_frame(ivf->map.buf + ivf->pos, (size_t) (ivf->map.size - ivf->pos), &offset, frame_size,
+                               pts, err) < 0) {
+        char msg[1024];
+        if (err->size > 0) {
+            snprintf(&msg[0], sizeof(msg), "%s", err->error);
+            tool_error(err, err->code, "At file offset %"PRIu64": %s", ivf->pos, msg);
+        }
+        return -1;
+    }
+
+    *frame       = ivf->map.buf + ivf->pos + offset;
+    *file_offset = ivf->pos + (uint64_t) offset;
+    ivf->pos    += (uint64_t) offset + *frame_size;
+
+    map_readahead(&ivf->map, ivf->pos);
+
+    return 0;
+}
+
+void ivf_close(IVFReader *ivf)
+{
+    map_close(&ivf->map);
+
+    memset(ivf, 0, sizeof(*ivf));
+}
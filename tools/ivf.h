@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Memory mapped IVF reader for the tools. The file is mapped once, and frames are
+ * handed out as pointers into the mapping, using obp_parse_ivf_header and
+ * obp_get_next_ivf_frame to walk it.
+ */
+
+#ifndef _OBUPARSE_IVF_INTERNAL
+#define _OBUPARSE_IVF_INTERNAL
+
+#include <stdint.h>
+
+#include "obuparse.h"
+#include "tools/map.h"
+
+typedef struct IVFReader {
+    FileMap map;
+    uint64_t pos;
+    OBPIVFHeader header;
+} IVFReader;
+
+/*
+ * Maps and validates an IVF file. Returns 0 on success, -1 on error.
+ */
+int ivf_open(IVFReader *ivf, const char *path, OBPError *err);
+
+/*
+ * Returns the next frame as a view into the mapping, valid until ivf_close.
+ * Returns 0 on success, 1 at the end of the file, and -1 on error.
+ */
+int ivf_read_frame(IVFReader *ivf, uint8_t **frame, size_t *frame_size, int64_t *pts, uint64_t *file_offset,
+                   OBPError *err);
+
+void ivf_close(IVFReader *ivf);
+
+#endif
@@ -147,6 +147,8 @@ void print_json_frame_header(OBPFrameHeader *my_struct)
     printf("    \"render_height_minus_1\": %"PRIu16",\n", my_struct->render_height_minus_1);
     printf("    \"RenderWidth\": %"PRIu32",\n", my_struct->RenderWidth);
     printf("    \"RenderHeight\": %"PRIu32",\n", my_struct->RenderHeight);
+    printf("    \"UpscaledWidth\": %"PRIu32",\n", my_struct->UpscaledWidth);
+    printf("    \"FrameHeight\": %"PRIu32",\n", my_struct->FrameHeight);
     printf("    \"allow_intrabc\": %d,\n", my_struct->allow_intrabc);
     printf("    \"frame_refs_short_signaling\": %d,\n", my_struct->frame_refs_short_signaling);
     printf("    \"last_frame_idx\": %"PRIu8",\n", my_struct->last_frame_idx);
@@ -340,7 +342,7 @@ void print_json_sequence_header(OBPSequenceHeader *my_struct)
     printf("    \"operating_points_cnt_minus_1\": %"PRIu8",\n", my_struct->operating_points_cnt_minus_1);
     printf("    \"operating_point_idc\": [\n");
     for (int i = 0; i < 32; i++) {
-        printf("    %"PRIu8"", my_struct->operating_point_idc[i]);
+        printf("    %"PRIu16"", my_struct->operating_point_idc[i]);
         printf("%s", i == 32 - 1 ? "\n" : ",\n");
     }
     printf("    ],\n");
@@ -426,7 +428,13 @@ void print_json_sequence_header(OBPSequenceHeader *my_struct)
     printf("        \"chroma_sample_position\": %d,\n", my_struct->color_config.chroma_sample_position);
     printf("        \"separate_uv_delta_q\": %d\n", my_struct->color_config.separate_uv_delta_q);
     printf("    },\n");
-    printf("    \"film_grain_params_present\": %d\n", my_struct->film_grain_params_present);
+    printf("    \"film_grain_params_present\": %d,\n", my_struct->film_grain_params_present);
+    printf("    \"idLen\": %"PRIu8",\n", my_struct->idLen);
+    printf("    \"OrderHintSignBit\": %"PRIu32",\n", my_struct->OrderHintSignBit);
+    printf("    \"OrderHintLowMask\": %"PRIu32",\n", my_struct->OrderHintLowMask);
+    printf("    \"sbShift\": %"PRIu8",\n", my_struct->sbShift);
+    printf("    \"OperatingPoint\": %"PRIu8",\n", my_struct->OperatingPoint);
+    printf("    \"OperatingPointIdc\": %"PRIu16"\n", my_struct->OperatingPointIdc);
     printf("}\n");
 }
 
@@ -471,21 +479,21 @@ void print_json_metadata(OBPMetadata *my_struct)
     printf("            \"temporal_group_description_present_flag\": %d,\n", my_struct->metadata_scalability.scalability_structure.temporal_group_description_present_flag);
     printf("            \"scalability_structure_reserved_3bits\": %"PRIu8",\n", my_struct->metadata_scalability.scalability_structure.scalability_structure_reserved_3bits);
     printf("            \"spatial_layer_max_width\": [\n");
-    for (int i = 0; i < 3; i++) {
+    for (int i = 0; i < 4; i++) {
         printf("            %"PRIu16"", my_struct->metadata_scalability.scalability_structure.spatial_layer_max_width[i]);
-        printf("%s", i == 3 - 1 ? "\n" : ",\n");
+        printf("%s", i == 4 - 1 ? "\n" : ",\n");
     }
     printf("            ],\n");
     printf("            \"spatial_layer_max_height\": [\n");
-    for (int i = 0; i < 3; i++) {
+    for (int i = 0; i < 4; i++) {
         printf("            %"PRIu16"", my_struct->metadata_scalability.scalability_structure.spatial_layer_max_height[i]);
-        printf("%s", i == 3 - 1 ? "\n" : ",\n");
+        printf("%s", i == 4 - 1 ? "\n" : ",\n");
     }
     printf("            ],\n");
     printf("            \"spatial_layer_ref_id\": [\n");
-    for (int i = 0; i < 3; i++) {
+    for (int i = 0; i < 4; i++) {
         printf("            %"PRIu8"", my_struct->metadata_scalability.scalability_structure.spatial_layer_ref_id[i]);
-        printf("%s", i == 3 - 1 ? "\n" : ",\n");
+        printf("%s", i == 4 - 1 ? "\n" : ",\n");
     }
     printf("            ],\n");
     printf("            \"temporal_group_size\": %"PRIu8",\n", my_struct->metadata_scalability.scalability_structure.temporal_group_size);
@@ -555,7 +563,7 @@ void print_json_tile_list(OBPTileList *my_struct)
     printf("    \"output_frame_height_in_tiles_minus_1\": %"PRIu8",\n", my_struct->output_frame_height_in_tiles_minus_1);
     printf("    \"tile_count_minus_1\": %"PRIu16",\n", my_struct->tile_count_minus_1);
     printf("    \"tile_list_entry\": [\n");
-    for (uint16_t i = 0; i <= my_struct->tile_count_minus_1; i++) {
+    for (uint32_t i = 0; i <= my_struct->tile_count_minus_1; i++) {
         printf("    {\n");
         printf("        \"anchor_frame_idx\": %"PRIu8",\n", my_struct->tile_list_entry[i].anchor_frame_idx);
         printf("        \"anchor_tile_row\": %"PRIu8",\n", my_struct->tile_list_entry[i].anchor_tile_row);
@@ -570,6 +578,23 @@ void print_json_tile_list(OBPTileList *my_struct)
     printf("}\n");
 }
 
+/*
+ * The tile arrays are optional, and only hold TileCapacity entries, so print them
+ * empty if they can't hold this tile group.
+ */
+static void print_json_tile_array(const char *name, uint32_t *array, OBPTileGroup *my_struct, int last)
+{
+    int have_tiles = array != NULL && my_struct->tg_end >= my_struct->tg_start &&
+                     (size_t) (my_struct->tg_end - my_struct->tg_start) < my_struct->TileCapacity;
+
+    printf("    \"%s\": [\n", name);
+    for (uint32_t i = my_struct->tg_start; have_tiles && i <= my_struct->tg_end; i++) {
+        printf("    %"PRIu32"", array[i - my_struct->tg_start]);
+        printf("%s", i == my_struct->tg_end ? "\n" : ",\n");
+    }
+    printf("    ]%s\n", last ? "" : ",");
+}
+
 void print_json_tile_group(OBPTileGroup *my_struct)
 {
     printf("{\n");
@@ -577,12 +602,27 @@ void print_json_tile_group(OBPTileGroup *my_struct)
     printf("    \"tile_start_and_end_present_flag\": %d,\n", my_struct->tile_start_and_end_present_flag);
     printf("    \"tg_start\": %"PRIu16",\n", my_struct->tg_start);
     printf("    \"tg_end\": %"PRIu16",\n", my_struct->tg_end);
-    printf("    \"TileSize\": [\n");
-    for (uint32_t i = my_struct->tg_start; i <= my_struct->tg_end; i++) {
-        printf("    %"PRIu64"", my_struct->TileSize[i]);
-        printf("%s", i == my_struct->tg_end ? "\n" : ",\n");
-    }
-    printf("    ]\n");
+    print_json_tile_array("TileSize", my_struct->TileSize, my_struct, 0);
+    print_json_tile_array("TileOffset", my_struct->TileOffset, my_struct, 1);
     printf("}\n");
 }
 
+void print_json_av1c(OBPAV1CodecConfig *my_struct)
+{
+    printf("{\n");
+    printf("    \"version\": %"PRIu8",\n", my_struct->version);
+    printf("    \"seq_profile\": %"PRIu8",\n", my_struct->seq_profile);
+    printf("    \"seq_level_idx_0\": %"PRIu8",\n", my_struct->seq_level_idx_0);
+    printf("    \"seq_tier_0\": %d,\n", my_struct->seq_tier_0);
+    printf("    \"high_bitdepth\": %d,\n", my_struct->high_bitdepth);
+    printf("    \"twelve_bit\": %d,\n", my_struct->twelve_bit);
+    printf("    \"monochrome\": %d,\n", my_struct->monochrome);
+    printf("    \"chroma_subsampling_x\": %d,\n", my_struct->chroma_subsampling_x);
+    printf("    \"chroma_subsampling_y\": %d,\n", my_struct->chroma_subsampling_y);
+    printf("    \"chroma_sample_position\": %d,\n", my_struct->chroma_sample_position);
+    printf("    \"initial_presentation_delay_present\": %d,\n", my_struct->initial_presentation_delay_present);
+    printf("    \"initial_presentation_delay_minus_one\": %"PRIu8",\n", my_struct->initial_presentation_delay_minus_one);
+    printf("    \"config_obus_offset\": %zu,\n", my_struct->config_obus_offset);
+    printf("    \"config_obus_size\": %zu\n", my_struct->config_obus_size);
+    printf("}\n");
+}
@@ -29,5 +29,6 @@ void print_json_sequence_header(OBPSequenceHeader *my_struct);
 void print_json_metadata(OBPMetadata *my_struct);
 void print_json_tile_list(OBPTileList *my_struct);
 void print_json_tile_group(OBPTileGroup *my_struct);
+void print_json_av1c(OBPAV1CodecConfig *my_struct);
 
 #endif
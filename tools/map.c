@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "obuparse.h"
+#include "tools/map.h"
+
+/* How far ahead of the read position to ask the OS to read in. */
+#define MAP_READAHEAD_SIZE (8 * 1024 * 1024)
+
+void tool_error(OBPError *err, OBPErrorCode code, const char *fmt, ...)
+{
+    va_list args;
+
+    err->code    = code;
+    err->bit_pos = 0;
+    err->element = NULL;
+
+    if (err->size > 0) {
+        va_start(args, fmt);
+        vsnprintf(err->error, err->size, fmt, args);
+        va_end(args);
+    }
+}
+
+#ifdef _WIN32
+int map_open(FileMap *map, const char *path, OBPError *err)
+{
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+
+    memset(map, 0, sizeof(*map));
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        tool_error(err, OBP_ERROR_INVALID_ARGUMENT, "Couldn't open '%s'.", path);
+        return -1;
+    }
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (uint64_t) size.QuadPart > SIZE_MAX) {
+        CloseHandle(file);
+        tool_error(err, OBP_ERROR_INVALID_DATA, "'%s' is empty or too large to be mapped.", path);
+        return -1;
+    }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        tool_error(err, OBP_ERROR_INVALID_STATE, "Couldn't map '%s'.", path);
+        return -1;
+    }
+
+    map->buf = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (map->buf == NULL) {
+        CloseHandle(mapping);
+        tool_error(err, OBP_ERROR_INVALID_STATE, "Couldn't map '%s'.", path);
+        return -1;
+    }
+
+    map->handle = mapping;
+    map->size   = (uint64_t) size.QuadPart;
+
+    return 0;
+}
+
+void map_readahead(FileMap *map, uint64_t pos)
+{
+    /* FILE_FLAG_SEQUENTIAL_SCAN already covers this. */
+    (void) map;
+    (void) pos;
+}
+
+static void map_unmap(FileMap *map)
+{
+    UnmapViewOfFile(map->buf);
+    CloseHandle(map->handle);
+}
+#else
+int map_open(FileMap *map, const char *path, OBPError *err)
+{
+    struct stat st;
+    void *buf;
+    int fd;
+
+    memset(map, 0, sizeof(*map));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        tool_error(err, OBP_ERROR_INVALID_ARGUMENT, "Couldn't open '%s'.", path);
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || (uint64_t) st.st_size > SIZE_MAX) {
+        close(fd);
+        tool_error(err, OBP_ERROR_INVALID_DATA, "'%s' is empty or too large to be mapped.", path);
+        return -1;
+    }
+
+    buf = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED) {
+        tool_error(err, OBP_ERROR_INVALID_STATE, "Couldn't map '%s'.", path);
+        return -1;
+    }
+
+    /* Hint failures are harmless, so they are ignored. */
+    posix_madvise(buf, (size_t) st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    map->buf  = buf;
+    map->size = (uint64_t) st.st_size;
+
+    return 0;
+}
+
+/*
+ * Keep one window of the file ahead of the read position in flight, issuing a new
+ * request each time half of the previous one has been consumed. Jumps forwards start
+ * a new window at the read position.
+ */
+void map_readahead(FileMap *map, uint64_t pos)
+{
+    uint64_t page_size = (uint64_t) sysconf(_SC_PAGESIZE);
+    uint64_t start, end;
+
+    if (map->readahead_pos >= map->size || pos + MAP_READAHEAD_SIZE / 2 < map->readahead_pos)
+        return;
+
+    start = (pos > map->readahead_pos ? pos : map->readahead_pos) & ~(page_size - 1);
+    end   = pos + MAP_READAHEAD_SIZE;
+    if (end > map->size)
+        end = map->size;
+
+    posix_madvise(map->buf + start, (size_t) (end - start), POSIX_MADV_WILLNEED);
+
+    map->readahead_pos = end;
+}
+
+static void map_unmap(FileMap *map)
+{
+    munmap(map->buf, (size_t) map->size);
+}
+#endif
+
+void map_close(FileMap *map)
+{
+    if (map->buf != NULL)
+        map_unmap(map);
+
+    memset(map, 0, sizeof(*map));
+}
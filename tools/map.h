@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Read-only file mapping shared by the tools' file readers, plus their error helper.
+ */
+
+#ifndef _OBUPARSE_MAP_INTERNAL
+#define _OBUPARSE_MAP_INTERNAL
+
+#include <stdint.h>
+
+#include "obuparse.h"
+
+typedef struct FileMap {
+    uint8_t *buf;
+    uint64_t size;
+    uint64_t readahead_pos;
+    void *handle;
+} FileMap;
+
+/*
+ * Maps a whole file read-only, hinting that it will be read sequentially.
+ * Returns 0 on success, -1 on error.
+ */
+int map_open(FileMap *map, const char *path, OBPError *err);
+
+/*
+ * Asks the OS to read in the part of the file following pos, the current read position.
+ */
+void map_readahead(FileMap *map, uint64_t pos);
+
+void map_close(FileMap *map);
+
+/*
+ * Fills in err like the library does, with no bit position or syntax element.
+ */
+void tool_error(OBPError *err, OBPErrorCode code, const char *fmt, ...);
+
+#endif
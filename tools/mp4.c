@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "obuparse.h"
+#include "tools/map.h"
+#include "tools/mp4.h"
+
+/* Size of the VisualSampleEntry fields which come before its child boxes. */
+#define MP4_VISUAL_SAMPLE_ENTRY_SIZE 78
+
+#define TFHD_BASE_DATA_OFFSET     0x000001
+#define TFHD_SAMPLE_DESC_INDEX    0x000002
+#define TFHD_DEFAULT_DURATION     0x000008
+#define TFHD_DEFAULT_SIZE         0x000010
+#define TFHD_DEFAULT_FLAGS        0x000020
+#define TFHD_DEFAULT_BASE_IS_MOOF 0x020000
+
+#define TRUN_DATA_OFFSET        0x000001
+#define TRUN_FIRST_SAMPLE_FLAGS 0x000004
+#define TRUN_DURATION           0x000100
+#define TRUN_SIZE               0x000200
+#define TRUN_FLAGS              0x000400
+#define TRUN_CTS_OFFSET         0x000800
+
+#define SAMPLE_IS_NON_SYNC 0x010000
+
+static uint64_t mp4_rb(uint8_t *buf, int n)
+{
+    uint64_t t = 0;
+    for (int i = 0; i < n; i++)
+        t = (t << 8) | buf[i];
+    return t;
+}
+
+static void mp4_error_at(OBPError *err, uint64_t pos)
+{
+    char msg[1024];
+
+    if (err->size > 0) {
+        snprintf(&msg[0], sizeof(msg), "%s", err->error);
+        tool_error(err, err->code, "At file offset %"PRIu64": %s", pos, msg);
+    }
+}
+
+/*
+ * Finds the first child box of a given type in a box payload. Returns 0 if it was found,
+ * 1 if not, and -1 on error.
+ */
+static int mp4_find_box(uint8_t *buf, size_t size, const char *type, uint8_t **payload, size_t *payload_size,
+                        OBPError *err)
+{
+    size_t pos = 0;
+
+    while (pos < size) {
+        uint8_t box_type[4];
+        ptrdiff_t offset;
+        size_t box_size;
+
+        if (obp_get_next_mp4_box(buf + pos, size - pos, box_type, &offset, &box_size, err) < 0)
+            return -1;
+
+        if (memcmp(&box_type[0], type, 4) == 0) {
+            *payload      = buf + pos + offset;
+            *payload_size = box_size;
+            return 0;
+        }
+
+        pos += (size_t) offset + box_size;
+    }
+
+    return 1;
+}
+
+static int mp4_require_box(uint8_t *buf, size_t size, const char *type, uint8_t **payload, size_t *payload_size,
+                           OBPError *err)
+{
+    int ret = mp4_find_box(buf, size, type, payload, payload_size, err);
+    if (ret == 1)
+        tool_error(err, OBP_ERROR_INVALID_DATA, "Missing '%.4s' box.", type);
+    return ret == 0 ? 0 : -1;
+}
+
+/*
+ * Sample table boxes are full boxes holding skip bytes of other fields, then an entry
+ * count, then the entries. Returns a pointer to the first entry.
+ */
+static int mp4_get_table(uint8_t *payload, size_t size, const char *type, size_t skip, size_t entry_size,
+                         uint8_t **entries, uint32_t *count, OBPError *err)
+{
+    if (size < 4 + skip + 4) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'%.4s' box is too small: %zu bytes.", type, size);
+        return -1;
+    }
+
+    *count   = (uint32_t) mp4_rb(payload + 4 + skip, 4);
+    *entries = payload + 4 + skip + 4;
+
+    if ((uint64_t) *count * entry_size > size - 4 - skip - 4) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'%.4s' box truncated: %"PRIu32" entries in %zu bytes.",
+                   type, *count, size);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Returns 0 if the track was an AV1 track and has been set up for reading, 1 if it is
+ * some other kind of track, and -1 on error.
+ */
+static int mp4_parse_track(MP4Reader *mp4, uint8_t *trak, size_t trak_size, OBPError *err)
+{
+    uint8_t *tkhd, *mdia, *mdhd, *minf, *stbl, *stsd, *entry, *av1c, *box;
+    size_t tkhd_size, mdia_size, mdhd_size, minf_size, stbl_size, stsd_size, entry_size, av1c_size, box_size;
+    uint8_t entry_type[4];
+    ptrdiff_t offset;
+    int ret;
+
+    if (mp4_require_box(trak, trak_size, "mdia", &mdia, &mdia_size, err) < 0 ||
+        mp4_require_box(mdia, mdia_size, "minf", &minf, &minf_size, err) < 0 ||
+        mp4_require_box(minf, minf_size, "stbl", &stbl, &stbl_size, err) < 0 ||
+        mp4_require_box(stbl, stbl_size, "stsd", &stsd, &stsd_size, err) < 0)
+        return -1;
+
+    if (stsd_size < 8) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'stsd' box is too small: %zu bytes.", stsd_size);
+        return -1;
+    }
+
+    if (obp_get_next_mp4_box(stsd + 8, stsd_size - 8, entry_type, &offset, &entry_size, err) < 0)
+        return -1;
+
+    if (memcmp(&entry_type[0], "av01", 4) != 0)
+        return 1;
+
+    entry = stsd + 8 + offset;
+    if (entry_size < MP4_VISUAL_SAMPLE_ENTRY_SIZE) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'av01' sample entry is too small: %zu bytes.", entry_size);
+        return -1;
+    }
+
+    if (mp4_require_box(entry + MP4_VISUAL_SAMPLE_ENTRY_SIZE, entry_size - MP4_VISUAL_SAMPLE_ENTRY_SIZE, "av1C",
+                        &av1c, &av1c_size, err) < 0)
+        return -1;
+
+    if (obp_parse_av1c(av1c, av1c_size, &mp4->config, &mp4->seq_header, &mp4->seq_header_present, err) < 0) {
+        mp4_error_at(err, (uint64_t) (av1c - mp4->map.buf));
+        return -1;
+    }
+
+    if (mp4_require_box(trak, trak_size, "tkhd", &tkhd, &tkhd_size, err) < 0 ||
+        mp4_require_box(mdia, mdia_size, "mdhd", &mdhd, &mdhd_size, err) < 0)
+        return -1;
+
+    if (tkhd_size < 1 || tkhd_size < (tkhd[0] == 1 ? 24 : 16) || mdhd_size < 1 || mdhd_size < (mdhd[0] == 1 ? 24 : 16)) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'tkhd' or 'mdhd' box is too small.");
+        return -1;
+    }
+
+    mp4->track_id  = (uint32_t) mp4_rb(tkhd + (tkhd[0] == 1 ? 20 : 12), 4);
+    mp4->timescale = (uint32_t) mp4_rb(mdhd + (mdhd[0] == 1 ? 20 : 12), 4);
+
+    if (mp4_require_box(stbl, stbl_size, "stsz", &box, &box_size, err) < 0)
+        return -1;
+    if (box_size < 8) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'stsz' box is too small: %zu bytes.", box_size);
+        return -1;
+    }
+    mp4->stsz_sample_size = (uint32_t) mp4_rb(box + 4, 4);
+    if (mp4_get_table(box, box_size, "stsz", 4, mp4->stsz_sample_size ? 0 : 4, &mp4->stsz, &mp4->num_samples, err) < 0)
+        return -1;
+
+    if (mp4_require_box(stbl, stbl_size, "stsc", &box, &box_size, err) < 0 ||
+        mp4_get_table(box, box_size, "stsc", 0, 12, &mp4->stsc, &mp4->stsc_count, err) < 0)
+        return -1;
+
+    if (mp4_require_box(stbl, stbl_size, "stts", &box, &box_size, err) < 0 ||
+        mp4_get_table(box, box_size, "stts", 0, 8, &mp4->stts, &mp4->stts_count, err) < 0)
+        return -1;
+
+    ret = mp4_find_box(stbl, stbl_size, "stco", &box, &box_size, err);
+    if (ret == 1) {
+        mp4->co64 = 1;
+        ret       = mp4_require_box(stbl, stbl_size, "co64", &box, &box_size, err);
+    }
+    if (ret < 0 || mp4_get_table(box, box_size, mp4->co64 ? "co64" : "stco", 0, mp4->co64 ? 8 : 4, &mp4->stco,
+                                 &mp4->stco_count, err) < 0)
+        return -1;
+
+    ret = mp4_find_box(stbl, stbl_size, "stss", &box, &box_size, err);
+    if (ret < 0 || (ret == 0 && mp4_get_table(box, box_size, "stss", 0, 4, &mp4->stss, &mp4->stss_count, err) < 0))
+        return -1;
+
+    return 0;
+}
+
+int mp4_open(MP4Reader *mp4, const char *path, OBPError *err)
+{
+    uint8_t *moov, *mvex;
+    size_t moov_size, mvex_size;
+    size_t pos = 0;
+    int found  = 0;
+    int ret;
+
+    memset(mp4, 0, sizeof(*mp4));
+
+    if (map_open(&mp4->map, path, err) < 0)
+        return -1;
+
+    if (mp4_require_box(mp4->map.buf, (size_t) mp4->map.size, "moov", &moov, &moov_size, err) < 0)
+        goto fail;
+
+    while (pos < moov_size && !found) {
+        uint8_t box_type[4];
+        ptrdiff_t offset;
+        size_t box_size;
+
+        if (obp_get_next_mp4_box(moov + pos, moov_size - pos, box_type, &offset, &box_size, err) < 0)
+            goto fail;
+
+        if (memcmp(&box_type[0], "trak", 4) == 0) {
+            ret = mp4_parse_track(mp4, moov + pos + offset, box_size, err);
+            if (ret < 0)
+                goto fail;
+            found = (ret == 0);
+        }
+
+        pos += (size_t) offset + box_size;
+    }
+
+    if (!found) {
+        tool_error(err, OBP_ERROR_NOT_FOUND, "No AV1 track found in '%s'.", path);
+        goto fail;
+    }
+
+    ret = mp4_find_box(moov, moov_size, "mvex", &mvex, &mvex_size, err);
+    if (ret < 0)
+        goto fail;
+
+    for (pos = 0; ret == 0 && pos < mvex_size;) {
+        uint8_t box_type[4];
+        ptrdiff_t offset;
+        size_t box_size;
+        uint8_t *trex;
+
+        if (obp_get_next_mp4_box(mvex + pos, mvex_size - pos, box_type, &offset, &box_size, err) < 0)
+            goto fail;
+
+        trex = mvex + pos + offset;
+        if (memcmp(&box_type[0], "trex", 4) == 0 && box_size >= 24 && mp4_rb(trex + 4, 4) == mp4->track_id) {
+            mp4->trex_duration = (uint32_t) mp4_rb(trex + 12, 4);
+            mp4->trex_size     = (uint32_t) mp4_rb(trex + 16, 4);
+            mp4->trex_flags    = (uint32_t) mp4_rb(trex + 20, 4);
+        }
+
+        pos += (size_t) offset + box_size;
+    }
+
+    return 0;
+
+fail:
+    mp4_close(mp4);
+    return -1;
+}
+
+static int mp4_read_table_sample(MP4Reader *mp4, uint8_t **sample, size_t *sample_size, int64_t *dts, int *sync,
+                                 uint64_t *file_offset, OBPError *err)
+{
+    uint32_t size;
+
+    while (mp4->chunk_samples_left == 0) {
+        if (mp4->chunk == mp4->stco_count || mp4->stsc_count == 0) {
+            tool_error(err, OBP_ERROR_INVALID_DATA, "Sample %"PRIu32" is past the last chunk.", mp4->sample);
+            return -1;
+        }
+        mp4->chunk++;
+
+        while (mp4->stsc_index + 1 < mp4->stsc_count && mp4->chunk >= mp4_rb(mp4->stsc + 12 * (mp4->stsc_index + 1), 4))
+            mp4->stsc_index++;
+
+        mp4->chunk_samples_left = (uint32_t) mp4_rb(mp4->stsc + 12 * mp4->stsc_index + 4, 4);
+        mp4->chunk_pos          = mp4->co64 ? mp4_rb(mp4->stco + 8 * (mp4->chunk - 1), 8)
+                                            : mp4_rb(mp4->stco + 4 * (mp4->chunk - 1), 4);
+    }
+
+    size = mp4->stsz_sample_size ? mp4->stsz_sample_size : (uint32_t) mp4_rb(mp4->stsz + 4 * mp4->sample, 4);
+    if (mp4->chunk_pos > mp4->map.size || size > mp4->map.size - mp4->chunk_pos) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "Sample %"PRIu32" at file offset %"PRIu64" runs past the end of the file.",
+                   mp4->sample, mp4->chunk_pos);
+        return -1;
+    }
+
+    while (mp4->stts_left == 0 && mp4->stts_index < mp4->stts_count) {
+        mp4->stts_left  = (uint32_t) mp4_rb(mp4->stts + 8 * mp4->stts_index, 4);
+        mp4->stts_delta = (uint32_t) mp4_rb(mp4->stts + 8 * mp4->stts_index + 4, 4);
+        mp4->stts_index++;
+    }
+    if (mp4->stts_left > 0)
+        mp4->stts_left--;
+
+    *sync = 1;
+    if (mp4->stss != NULL) {
+        while (mp4->stss_index < mp4->stss_count && mp4_rb(mp4->stss + 4 * mp4->stss_index, 4) < mp4->sample + 1)
+            mp4->stss_index++;
+        *sync = mp4->stss_index < mp4->stss_count && mp4_rb(mp4->stss + 4 * mp4->stss_index, 4) == mp4->sample + 1;
+    }
+
+    *sample      = mp4->map.buf + mp4->chunk_pos;
+    *sample_size = size;
+    *dts         = mp4->dts;
+    *file_offset = mp4->chunk_pos;
+
+    mp4->dts       += mp4->stts_delta;
+    mp4->chunk_pos += size;
+    mp4->chunk_samples_left--;
+    mp4->sample++;
+
+    return 0;
+}
+
+static int mp4_parse_traf(MP4Reader *mp4, uint8_t *traf, size_t traf_size, OBPError *err)
+{
+    uint8_t *tfhd, *tfdt;
+    size_t tfhd_size, tfdt_size, pos;
+    int first_traf = mp4->first_traf;
+    int ret;
+
+    mp4->first_traf = 0;
+
+    if (mp4_require_box(traf, traf_size, "tfhd", &tfhd, &tfhd_size, err) < 0)
+        return -1;
+
+    if (tfhd_size < 8) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'tfhd' box is too small: %zu bytes.", tfhd_size);
+        return -1;
+    }
+
+    if (mp4_rb(tfhd + 4, 4) != mp4->track_id)
+        return 0;
+
+    mp4->tfhd_flags = (uint32_t) mp4_rb(tfhd, 4) & 0xFFFFFF;
+
+    pos = 8 + ((mp4->tfhd_flags & TFHD_BASE_DATA_OFFSET) ? 8 : 0) + ((mp4->tfhd_flags & TFHD_SAMPLE_DESC_INDEX) ? 4 : 0) +
+          ((mp4->tfhd_flags & TFHD_DEFAULT_DURATION) ? 4 : 0) + ((mp4->tfhd_flags & TFHD_DEFAULT_SIZE) ? 4 : 0) +
+          ((mp4->tfhd_flags & TFHD_DEFAULT_FLAGS) ? 4 : 0);
+    if (tfhd_size < pos) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'tfhd' box truncated: %zu bytes needed, %zu available.", pos, tfhd_size);
+        return -1;
+    }
+
+    pos = 8;
+    if (mp4->tfhd_flags & TFHD_BASE_DATA_OFFSET) {
+        mp4->base_data_offset = mp4_rb(tfhd + pos, 8);
+        pos += 8;
+    } else if ((mp4->tfhd_flags & TFHD_DEFAULT_BASE_IS_MOOF) || first_traf) {
+        mp4->base_data_offset = mp4->moof_start;
+    } else {
+        mp4->base_data_offset = mp4->data_end;
+    }
+    if (mp4->tfhd_flags & TFHD_SAMPLE_DESC_INDEX)
+        pos += 4;
+
+    mp4->default_duration = mp4->trex_duration;
+    mp4->default_size     = mp4->trex_size;
+    mp4->default_flags    = mp4->trex_flags;
+    if (mp4->tfhd_flags & TFHD_DEFAULT_DURATION) {
+        mp4->default_duration = (uint32_t) mp4_rb(tfhd + pos, 4);
+        pos += 4;
+    }
+    if (mp4->tfhd_flags & TFHD_DEFAULT_SIZE) {
+        mp4->default_size = (uint32_t) mp4_rb(tfhd + pos, 4);
+        pos += 4;
+    }
+    if (mp4->tfhd_flags & TFHD_DEFAULT_FLAGS)
+        mp4->default_flags = (uint32_t) mp4_rb(tfhd + pos, 4);
+
+    ret = mp4_find_box(traf, traf_size, "tfdt", &tfdt, &tfdt_size, err);
+    if (ret < 0)
+        return -1;
+    if (ret == 0) {
+        if (tfdt_size < 1 || tfdt_size < (tfdt[0] == 1 ? 12 : 8)) {
+            tool_error(err, OBP_ERROR_OUT_OF_DATA, "'tfdt' box is too small: %zu bytes.", tfdt_size);
+            return -1;
+        }
+        mp4->dts = (int64_t) mp4_rb(tfdt + 4, tfdt[0] == 1 ? 8 : 4);
+    }
+
+    mp4->traf_pos   = (uint64_t) (traf - mp4->map.buf);
+    mp4->traf_end   = mp4->traf_pos + traf_size;
+    mp4->first_trun = 1;
+
+    return 0;
+}
+
+static int mp4_parse_trun(MP4Reader *mp4, uint8_t *trun, size_t trun_size, OBPError *err)
+{
+    size_t pos = 8;
+    uint32_t count;
+
+    if (trun_size < 8) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'trun' box is too small: %zu bytes.", trun_size);
+        return -1;
+    }
+
+    mp4->trun_flags      = (uint32_t) mp4_rb(trun, 4) & 0xFFFFFF;
+    count                = (uint32_t) mp4_rb(trun + 4, 4);
+    mp4->trun_entry_size = 4 * (!!(mp4->trun_flags & TRUN_DURATION) + !!(mp4->trun_flags & TRUN_SIZE) +
+                                !!(mp4->trun_flags & TRUN_FLAGS) + !!(mp4->trun_flags & TRUN_CTS_OFFSET));
+
+    if (trun_size < pos + ((mp4->trun_flags & TRUN_DATA_OFFSET) ? 4 : 0) + ((mp4->trun_flags & TRUN_FIRST_SAMPLE_FLAGS) ? 4 : 0)) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'trun' box is too small: %zu bytes.", trun_size);
+        return -1;
+    }
+
+    if (mp4->trun_flags & TRUN_DATA_OFFSET) {
+        int64_t data_offset = (int32_t) (uint32_t) mp4_rb(trun + pos, 4);
+        if (data_offset < 0 && (uint64_t) -data_offset > mp4->base_data_offset) {
+            tool_error(err, OBP_ERROR_INVALID_DATA, "Invalid 'trun' data offset: %"PRId64".", data_offset);
+            return -1;
+        }
+        mp4->trun_data_pos = (uint64_t) ((int64_t) mp4->base_data_offset + data_offset);
+        pos += 4;
+    } else {
+        mp4->trun_data_pos = mp4->first_trun ? mp4->base_data_offset : mp4->data_end;
+    }
+
+    if (mp4->trun_flags & TRUN_FIRST_SAMPLE_FLAGS) {
+        mp4->first_sample_flags = (uint32_t) mp4_rb(trun + pos, 4);
+        pos += 4;
+    }
+
+    if ((uint64_t) count * mp4->trun_entry_size > trun_size - pos) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "'trun' box truncated: %"PRIu32" entries in %zu bytes.", count, trun_size);
+        return -1;
+    }
+
+    mp4->trun       = trun + pos;
+    mp4->trun_left  = count;
+    mp4->trun_first = 1;
+    mp4->first_trun = 0;
+
+    return 0;
+}
+
+static int mp4_read_fragment_sample(MP4Reader *mp4, uint8_t **sample, size_t *sample_size, int64_t *dts, int *sync,
+                                    uint64_t *file_offset, OBPError *err)
+{
+    uint32_t duration, size, flags;
+    size_t pos = 0;
+
+    while (mp4->trun_left == 0) {
+        uint64_t *box_pos, box_end;
+        uint8_t box_type[4];
+        ptrdiff_t offset;
+        size_t box_size;
+        uint8_t *payload;
+        int ret = 0;
+
+        if (mp4->traf_pos < mp4->traf_end) {
+            box_pos = &mp4->traf_pos;
+            box_end = mp4->traf_end;
+        } else if (mp4->moof_pos < mp4->moof_end) {
+            box_pos = &mp4->moof_pos;
+            box_end = mp4->moof_end;
+        } else if (mp4->box_pos < mp4->map.size) {
+            box_pos = &mp4->box_pos;
+            box_end = mp4->map.size;
+        } else {
+            return 1;
+        }
+
+        if (obp_get_next_mp4_box(mp4->map.buf + *box_pos, (size_t) (box_end - *box_pos), box_type, &offset,
+                                 &box_size, err) < 0) {
+            mp4_error_at(err, *box_pos);
+            return -1;
+        }
+
+        payload   = mp4->map.buf + *box_pos + offset;
+        *box_pos += (uint64_t) offset + box_size;
+
+        if (box_pos == &mp4->traf_pos && memcmp(&box_type[0], "trun", 4) == 0) {
+            ret = mp4_parse_trun(mp4, payload, box_size, err);
+        } else if (box_pos == &mp4->moof_pos && memcmp(&box_type[0], "traf", 4) == 0) {
+            ret = mp4_parse_traf(mp4, payload, box_size, err);
+        } else if (box_pos == &mp4->box_pos && memcmp(&box_type[0], "moof", 4) == 0) {
+            mp4->moof_start = (uint64_t) (payload - offset - mp4->map.buf);
+            mp4->moof_pos   = (uint64_t) (payload - mp4->map.buf);
+            mp4->moof_end   = mp4->moof_pos + box_size;
+            mp4->first_traf = 1;
+        }
+        if (ret < 0) {
+            mp4_error_at(err, (uint64_t) (payload - mp4->map.buf));
+            return -1;
+        }
+    }
+
+    duration = mp4->default_duration;
+    size     = mp4->default_size;
+    flags    = mp4->default_flags;
+    if (mp4->trun_flags & TRUN_DURATION) {
+        duration = (uint32_t) mp4_rb(mp4->trun + pos, 4);
+        pos += 4;
+    }
+    if (mp4->trun_flags & TRUN_SIZE) {
+        size = (uint32_t) mp4_rb(mp4->trun + pos, 4);
+        pos += 4;
+    }
+    if (mp4->trun_flags & TRUN_FLAGS)
+        flags = (uint32_t) mp4_rb(mp4->trun + pos, 4);
+    if (mp4->trun_first && (mp4->trun_flags & TRUN_FIRST_SAMPLE_FLAGS))
+        flags = mp4->first_sample_flags;
+
+    if (mp4->trun_data_pos > mp4->map.size || size > mp4->map.size - mp4->trun_data_pos) {
+        tool_error(err, OBP_ERROR_OUT_OF_DATA, "Sample at file offset %"PRIu64" runs past the end of the file.",
+                   mp4->trun_data_pos);
+        return -1;
+    }
+
+    *sample      = mp4->map.buf + mp4->trun_data_pos;
+    *sample_size = size;
+    *dts         = mp4->dts;
+    *sync        = !(flags & SAMPLE_IS_NON_SYNC);
+    *file_offset = mp4->trun_data_pos;
+
+    mp4->dts           += duration;
+    mp4->trun_data_pos += size;
+    mp4->data_end       = mp4->trun_data_pos;
+    mp4->trun          += mp4->trun_entry_size;
+    mp4->trun_first     = 0;
+    mp4->trun_left--;
+
+    return 0;
+}
+
+int mp4_read_sample(MP4Reader *mp4, uint8_t **sample, size_t *sample_size, int64_t *dts, int *sync,
+                    uint64_t *file_offset, OBPError *err)
+{
+    int ret;
+
+    if (mp4->sample < mp4->num_samples)
+        ret = mp4_read_table_sample(mp4, sample, sample_size, dts, sync, file_offset, err);
+    else
+        ret = mp4_read_fragment_sample(mp4, sample, sample_size, dts, sync, file_offset, err);
+
+    if (ret == 0)
+        map_readahead(&mp4->map, *file_offset + *sample_size);
+
+    return ret;
+}
+
+void mp4_close(MP4Reader *mp4)
+{
+    map_close(&mp4->map);
+
+    memset(mp4, 0, sizeof(*mp4));
+}
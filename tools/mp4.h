@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Memory mapped MP4 (ISOBMFF) reader for the tools. It finds the first AV1 track, parses
+ * its 'av1C' with obp_parse_av1c, and hands out samples as pointers into the mapping, from
+ * the track's sample tables first, and then from any movie fragments. Sample sizes in
+ * 'stz2' and edit lists are not supported.
+ */
+
+#ifndef _OBUPARSE_MP4_INTERNAL
+#define _OBUPARSE_MP4_INTERNAL
+
+#include <stdint.h>
+
+#include "obuparse.h"
+#include "tools/map.h"
+
+typedef struct MP4Reader {
+    FileMap map;
+    uint32_t track_id;
+    uint32_t timescale;
+    OBPAV1CodecConfig config;
+    OBPSequenceHeader seq_header; /* From configOBUs, if seq_header_present is set. */
+    int seq_header_present;
+
+    /* Sample tables, pointing at the first entry of each, and the position in them. */
+    uint8_t *stsz, *stsc, *stco, *stts, *stss;
+    uint32_t stsz_sample_size;
+    uint32_t num_samples;
+    uint32_t stsc_count, stco_count, stts_count, stss_count;
+    int co64;
+    uint32_t sample, chunk, chunk_samples_left, stsc_index, stts_index, stts_left, stts_delta, stss_index;
+    uint64_t chunk_pos;
+    int64_t dts;
+
+    /* Defaults from 'trex', and the position in the movie fragments. */
+    uint32_t trex_duration, trex_size, trex_flags;
+    uint64_t box_pos;
+    uint64_t moof_start, moof_pos, moof_end;
+    uint64_t traf_pos, traf_end;
+    uint64_t data_end;
+    int first_traf, first_trun;
+    uint64_t base_data_offset;
+    uint32_t tfhd_flags, default_duration, default_size, default_flags;
+
+    /* The 'trun' currently being read. */
+    uint8_t *trun;
+    uint32_t trun_flags, trun_left, trun_entry_size, first_sample_flags;
+    int trun_first;
+    uint64_t trun_data_pos;
+} MP4Reader;
+
+/*
+ * Maps an MP4 file and finds its first AV1 track. Returns 0 on success, -1 on error.
+ */
+int mp4_open(MP4Reader *mp4, const char *path, OBPError *err);
+
+/*
+ * Returns the next sample of the AV1 track as a view into the mapping, valid until
+ * mp4_close. dts is in the track's timescale, and sync is set for sync samples.
+ * Returns 0 on success, 1 at the end of the file, and -1 on error.
+ */
+int mp4_read_sample(MP4Reader *mp4, uint8_t **sample, size_t *sample_size, int64_t *dts, int *sync,
+                    uint64_t *file_offset, OBPError *err);
+
+void mp4_close(MP4Reader *mp4);
+
+#endif
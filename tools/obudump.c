@@ -15,19 +15,10 @@
  */
 
 /*
- * Currently just an ad-hoc IVF parser to feed packets into obuparse to
+ * Currently just feeds packets from an IVF or MP4 file into obuparse to
  * help spot-check APIs.
  */
 
-#ifdef _WIN32
-#define fseeko _fseeki64
-#define ftello _fseeki64
-#define off_t __int64
-#else
-#define _FILE_OFFSET_BITS 64
-#define _LARGEFILE_SOURCE
-#endif
-
 #include <assert.h>
 #include <inttypes.h>
 #include <stdint.h>
@@ -36,7 +27,9 @@
 #include <string.h>
 
 #include "obuparse.h"
+#include "tools/ivf.h"
 #include "tools/json.h"
+#include "tools/mp4.h"
 
 const char *obu_type_to_str(int obu_type)
 {
@@ -71,18 +64,41 @@ const char *obu_type_to_str(int obu_type)
     }
 }
 
+static int is_ivf(const char *path)
+{
+    char sig[4] = { 0 };
+    FILE *f     = fopen(path, "rb");
+
+    if (f == NULL)
+        return 0;
+
+    if (fread(&sig[0], 1, 4, f) != 4)
+        sig[0] = 0;
+    fclose(f);
+
+    return !memcmp(&sig[0], "DKIF", 4);
+}
+
 int main(int argc, char *argv[])
 {
-    FILE *ivf             = NULL;
+    IVFReader ivf         = { 0 };
+    MP4Reader mp4         = { 0 };
+    int use_mp4           = 0;
+    char ivf_err_buf[1024];
+    OBPError ivf_err      = { &ivf_err_buf[0], 1024, OBP_ERROR_NONE, 0, NULL };
     int packet_count      = 0;
     int ret               = 0;
-    OBPSequenceHeader hdr = { 0 };
+    OBPSequenceHeader *hdr = NULL;
+    static OBPSequenceHeaderCache seq_cache;
     OBPState state        = { 0 };
     int seen_seq          = 0;
     int verbose           = 0;
+    static uint32_t tile_sizes[4096];
+    static uint32_t tile_offsets[4096];
+    static OBPTileListEntry tile_list_entries[65536];
 
     if (argc < 2) {
-        printf("Usage: %s (--verbose) file.ivf\n", argv[0]);
+        printf("Usage: %s (--verbose) file.ivf|file.mp4\n", argv[0]);
         return 1;
     }
 
@@ -90,62 +106,53 @@ int main(int argc, char *argv[])
         verbose = 1;
     }
 
-    ivf = fopen(argv[argc - 1], "rb");
-    if (ivf == NULL) {
-        printf("Couldn't open '%s'.\n", argv[1]);
-        ret = 1;
-        goto end;
-    }
+    use_mp4 = !is_ivf(argv[argc - 1]);
 
-    /* Skip IVF global header. */
-    ret = fseeko(ivf, 32, SEEK_SET);
-    if (ret != 0) {
-        printf("Failed to seek past IVF header.\n");
+    if (use_mp4) {
+        if (mp4_open(&mp4, argv[argc - 1], &ivf_err) < 0) {
+            printf("Failed to open MP4 file: %s\n", ivf_err.error);
+            ret = 1;
+            goto end;
+        }
+        print_json_av1c(&mp4.config);
+        if (mp4.seq_header_present) {
+            hdr      = &mp4.seq_header;
+            seen_seq = 1;
+            print_json_sequence_header(hdr);
+        }
+    } else if (ivf_open(&ivf, argv[argc - 1], &ivf_err) < 0) {
+        printf("Failed to open IVF file: %s\n", ivf_err.error);
         ret = 1;
         goto end;
     }
 
-    while (!feof(ivf))
+    while (1)
     {
-        uint8_t frame_header[12];
         uint8_t *packet_buf;
         size_t packet_size;
         size_t packet_pos = 0;
+        int64_t pts;
+        uint64_t file_offset;
         OBPFrameHeader frame_hdr = {0};
         int SeenFrameHeader = 0;
 
-        size_t read_in = fread(&frame_header[0], 1, 12, ivf);
-        if (read_in != 12) {
-            if (feof(ivf))
-                break;
-            printf("Failed to read in IVF frame header (read %zu)\n", read_in);
+        if (use_mp4) {
+            int sync;
+            ret = mp4_read_sample(&mp4, &packet_buf, &packet_size, &pts, &sync, &file_offset, &ivf_err);
+        } else {
+            ret = ivf_read_frame(&ivf, &packet_buf, &packet_size, &pts, &file_offset, &ivf_err);
+        }
+        if (ret == 1) {
+            ret = 0;
+            break;
+        } else if (ret < 0) {
+            printf("Failed to read in %s: %s\n", use_mp4 ? "MP4 sample" : "IVF frame", ivf_err.error);
             ret = 1;
             goto end;
         }
 
-        assert(sizeof(packet_size) >= 4);
-
-        packet_size =  frame_header[0]        +
-                      (frame_header[1] << 8)  +
-                      (frame_header[2] << 16) +
-                      (frame_header[3] << 24);
-
         printf("{\"packet_number\": %d, \"packet_size\": %zu}\n", packet_count, packet_size);
 
-        packet_buf = malloc(packet_size);
-        if (packet_buf == NULL) {
-            printf("Could not allocate packet buffer.\n");
-            ret = 1;
-            goto end;
-        }
-
-        read_in = fread(packet_buf, 1, packet_size, ivf);
-        if (read_in != packet_size) {
-            free(packet_buf);
-            printf("Could not read in packet (read %zu)\n", read_in);
-            ret = 1;
-            goto end;
-        }
         packet_count++;
 
         while (packet_pos < packet_size)
@@ -155,12 +162,11 @@ int main(int argc, char *argv[])
             size_t obu_size;
             int temporal_id, spatial_id;
             OBPOBUType obu_type;
-            OBPError err = { &err_buf[0], 1024 };
+            OBPError err = { &err_buf[0], 1024, OBP_ERROR_NONE, 0, NULL };
 
             ret = obp_get_next_obu(packet_buf + packet_pos, packet_size - packet_pos, 
                                    &obu_type, &offset, &obu_size, &temporal_id, &spatial_id, &err);
             if (ret < 0) {
-                free(packet_buf);
                 printf("Failed to parse OBU header: %s\n", err.error);
                 ret = 1;
                 goto end;
@@ -181,30 +187,43 @@ int main(int argc, char *argv[])
                 break;
             }
             case OBP_OBU_SEQUENCE_HEADER: {
+                int changed;
                 seen_seq = 1;
-                memset(&hdr, 0, sizeof(hdr));
-                ret = obp_parse_sequence_header(packet_buf + packet_pos + offset, obu_size, &hdr, &err);
+                ret = obp_parse_sequence_header_cached(packet_buf + packet_pos + offset, obu_size, &seq_cache,
+                                                       &hdr, &changed, &err);
                 if (ret < 0) {
-                    free(packet_buf);
                     printf("Failed to parse sequence header: %s\n", err.error);
                     ret = 1;
                     goto end;
                 }
-                print_json_sequence_header(&hdr);
+                if (verbose && changed)
+                    printf("{\"sequence_header_changed\": true}\n");
+                if (verbose) {
+                    const char *codec_string;
+                    ret = obp_get_codec_string_cached(&seq_cache, &codec_string, &err);
+                    if (ret < 0) {
+                        printf("Failed to get codec string: %s\n", err.error);
+                        ret = 1;
+                        goto end;
+                    }
+                    printf("{\"codec_string\": \"%s\"}\n", codec_string);
+                }
+                print_json_sequence_header(hdr);
                 break;
             }
             case OBP_OBU_FRAME: {
                 OBPTileGroup tiles = { 0 };
+                tiles.TileSize     = &tile_sizes[0];
+                tiles.TileOffset   = &tile_offsets[0];
+                tiles.TileCapacity = 4096;
                 memset(&frame_hdr, 0, sizeof(frame_hdr));
                 if (!seen_seq) {
-                    free(packet_buf);
                     printf("Encountered Frame Header OBU before Sequence Header OBU.\n");
                     ret = 1;
                     goto end;
                 }
-                ret = obp_parse_frame(packet_buf + packet_pos + offset, obu_size, &hdr, &state, temporal_id, spatial_id, &frame_hdr, &tiles, &SeenFrameHeader, &err);
+                ret = obp_parse_frame(packet_buf + packet_pos + offset, obu_size, hdr, &state, temporal_id, spatial_id, &frame_hdr, &tiles, &SeenFrameHeader, &err);
                 if (ret < 0) {
-                    free(packet_buf);
                     printf("Failed to parse frame header: %s\n", err.error);
                     ret = 1;
                     goto end;
@@ -217,14 +236,12 @@ int main(int argc, char *argv[])
             case OBP_OBU_FRAME_HEADER: {
                 memset(&frame_hdr, 0, sizeof(frame_hdr));
                 if (!seen_seq) {
-                    free(packet_buf);
                     printf("Encountered Frame Header OBU before Sequence Header OBU.\n");
                     ret = 1;
                     goto end;
                 }
-                ret = obp_parse_frame_header(packet_buf + packet_pos + offset, obu_size, &hdr, &state, temporal_id, spatial_id, &frame_hdr, &SeenFrameHeader, &err);
+                ret = obp_parse_frame_header(packet_buf + packet_pos + offset, obu_size, hdr, &state, temporal_id, spatial_id, &frame_hdr, &SeenFrameHeader, &err);
                 if (ret < 0) {
-                    free(packet_buf);
                     printf("Failed to parse frame header: %s\n", err.error);
                     ret = 1;
                     goto end;
@@ -233,10 +250,11 @@ int main(int argc, char *argv[])
                 break;
             }
             case OBP_OBU_TILE_LIST: {
-                OBPTileList tile_list = { 0 };
+                OBPTileList tile_list              = { 0 };
+                tile_list.tile_list_entry          = &tile_list_entries[0];
+                tile_list.tile_list_entry_capacity = 65536;
                 ret = obp_parse_tile_list(packet_buf + packet_pos + offset, obu_size, &tile_list, &err);
                 if (ret < 0) {
-                    free(packet_buf);
                     printf("Failed to parse metadata: %s\n", err.error);
                     ret = 1;
                     goto end;
@@ -246,9 +264,11 @@ int main(int argc, char *argv[])
             }
             case OBP_OBU_TILE_GROUP: {
                 OBPTileGroup tiles = { 0 };
+                tiles.TileSize     = &tile_sizes[0];
+                tiles.TileOffset   = &tile_offsets[0];
+                tiles.TileCapacity = 4096;
                 ret = obp_parse_tile_group(packet_buf + packet_pos + offset, obu_size, &frame_hdr, &tiles, &SeenFrameHeader, &err);
                 if (ret < 0) {
-                    free(packet_buf);
                     printf("Failed to parse tile group: %s\n", err.error);
                     ret = 1;
                     goto end;
@@ -260,7 +280,6 @@ int main(int argc, char *argv[])
                 OBPMetadata meta = { 0 };
                 ret = obp_parse_metadata(packet_buf + packet_pos + offset, obu_size, &meta, &err);
                 if (ret < 0) {
-                    free(packet_buf);
                     printf("Failed to parse metadata: %s\n", err.error);
                     ret = 1;
                     goto end;
@@ -275,8 +294,6 @@ int main(int argc, char *argv[])
             packet_pos += obu_size + (size_t) offset;
         }
 
-        free(packet_buf);
-
         if (packet_pos != packet_size) {
             printf("Didn't consume whole packet (%zu vs %zu).\n", packet_size, packet_pos);
             ret = 1;
@@ -285,8 +302,8 @@ int main(int argc, char *argv[])
     }
 
 end:
-    if (ivf != NULL)
-        fclose(ivf);
+    ivf_close(&ivf);
+    mp4_close(&mp4);
 
     return ret;
 }
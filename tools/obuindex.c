@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Builds a seek index of the random access points in an IVF or MP4 file, using
+ * obp_seek_index_push_frame, and looks timestamps up in one.
+ *
+ * Offsets are the file positions of the temporal units' data, and timestamps are
+ * in the file's timebase. In MP4 files, a sequence header in 'av1C' counts as
+ * being in every temporal unit.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "obuparse.h"
+#include "tools/ivf.h"
+#include "tools/map.h"
+#include "tools/mp4.h"
+
+static int is_ivf(const char *path)
+{
+    char sig[4] = { 0 };
+    FILE *f     = fopen(path, "rb");
+
+    if (f == NULL)
+        return 0;
+
+    if (fread(&sig[0], 1, 4, f) != 4)
+        sig[0] = 0;
+    fclose(f);
+
+    return !memcmp(&sig[0], "DKIF", 4);
+}
+
+static void print_point(uint64_t index, OBPSeekPoint *point)
+{
+    printf("{\"index\": %"PRIu64", \"pts\": %"PRId64", \"offset\": %"PRIu64", \"forward_key_frame\": %s}\n",
+           index, point->pts, point->offset, point->forward_key_frame ? "true" : "false");
+}
+
+static int build_index(const char *in_path, const char *out_path)
+{
+    IVFReader ivf          = { 0 };
+    MP4Reader mp4          = { 0 };
+    int use_mp4            = 0;
+    char err_buf[1024];
+    OBPError err           = { &err_buf[0], 1024, OBP_ERROR_NONE, 0, NULL };
+    OBPSequenceHeader hdr  = { 0 };
+    OBPSeekIndexBuilder builder = { 0 };
+    static OBPState state;
+    int seen_seq           = 0;
+    int config_seq         = 0;
+    int SeenFrameHeader    = 0;
+    uint64_t num_points    = 0;
+    uint8_t buf[OBP_SEEK_INDEX_HEADER_SIZE];
+    FILE *out              = NULL;
+    int ret                = 0;
+
+    use_mp4 = !is_ivf(in_path);
+
+    if (use_mp4) {
+        if (mp4_open(&mp4, in_path, &err) < 0) {
+            printf("Failed to open MP4 file: %s\n", err.error);
+            return 1;
+        }
+        if (mp4.seq_header_present) {
+            memcpy(&hdr, &mp4.seq_header, sizeof(hdr));
+            seen_seq   = 1;
+            config_seq = 1;
+        }
+    } else if (ivf_open(&ivf, in_path, &err) < 0) {
+        printf("Failed to open IVF file: %s\n", err.error);
+        return 1;
+    }
+
+    out = fopen(out_path, "wb");
+    if (out == NULL) {
+        printf("Failed to open '%s' for writing.\n", out_path);
+        ret = 1;
+        goto end;
+    }
+
+    /* Written again at the end, once the number of points is known. */
+    obp_seek_index_write_header(0, &buf[0], sizeof(buf), &err);
+    if (fwrite(&buf[0], 1, OBP_SEEK_INDEX_HEADER_SIZE, out) != OBP_SEEK_INDEX_HEADER_SIZE) {
+        printf("Failed to write seek index header.\n");
+        ret = 1;
+        goto end;
+    }
+
+    while (1)
+    {
+        uint8_t *packet_buf;
+        size_t packet_size;
+        size_t packet_pos  = 0;
+        int64_t pts;
+        uint64_t file_offset;
+        int has_seq_header = config_seq;
+
+        if (use_mp4) {
+            int sync;
+            ret = mp4_read_sample(&mp4, &packet_buf, &packet_size, &pts, &sync, &file_offset, &err);
+        } else {
+            ret = ivf_read_frame(&ivf, &packet_buf, &packet_size, &pts, &file_offset, &err);
+        }
+        if (ret == 1) {
+            ret = 0;
+            break;
+        } else if (ret < 0) {
+            printf("Failed to read in %s: %s\n", use_mp4 ? "MP4 sample" : "IVF frame", err.error);
+            ret = 1;
+            goto end;
+        }
+
+        while (packet_pos < packet_size)
+        {
+            ptrdiff_t offset;
+            size_t obu_size;
+            int temporal_id, spatial_id;
+            OBPOBUType obu_type;
+            uint8_t *obu;
+
+            ret = obp_get_next_obu(packet_buf + packet_pos, packet_size - packet_pos,
+                                   &obu_type, &offset, &obu_size, &temporal_id, &spatial_id, &err);
+            if (ret < 0) {
+                printf("Failed to parse OBU header: %s\n", err.error);
+                ret = 1;
+                goto end;
+            }
+            obu = packet_buf + packet_pos + offset;
+
+            if (obu_type == OBP_OBU_TEMPORAL_DELIMITER) {
+                SeenFrameHeader = 0;
+            } else if (obu_type == OBP_OBU_SEQUENCE_HEADER) {
+                memset(&hdr, 0, sizeof(hdr));
+                ret = obp_parse_sequence_header(obu, obu_size, &hdr, &err);
+                if (ret < 0) {
+                    printf("Failed to parse sequence header: %s\n", err.error);
+                    ret = 1;
+                    goto end;
+                }
+                seen_seq       = 1;
+                has_seq_header = 1;
+            } else if (obu_type == OBP_OBU_FRAME || obu_type == OBP_OBU_FRAME_HEADER) {
+                OBPFrameHeader frame_hdr;
+                OBPSeekPoint point;
+                int has_point;
+
+                if (!seen_seq) {
+                    printf("Encountered Frame Header OBU before Sequence Header OBU.\n");
+                    ret = 1;
+                    goto end;
+                }
+
+                /* Only the fields before tile_info() are needed. */
+                memset(&frame_hdr, 0, sizeof(frame_hdr));
+                ret = obp_parse_frame_header_fields(obu, obu_size, &hdr, &state, temporal_id, spatial_id, 0,
+                                                    &frame_hdr, &SeenFrameHeader, &err);
+                if (ret < 0) {
+                    printf("Failed to parse frame header: %s\n", err.error);
+                    ret = 1;
+                    goto end;
+                }
+
+                ret = obp_seek_index_push_frame(&builder, &frame_hdr, pts, file_offset, has_seq_header,
+                                                &point, &has_point, &err);
+                if (ret < 0) {
+                    printf("Failed to index frame: %s\n", err.error);
+                    ret = 1;
+                    goto end;
+                }
+                if (has_point) {
+                    uint8_t point_buf[OBP_SEEK_INDEX_POINT_SIZE];
+                    obp_seek_index_write_point(&point, &point_buf[0], sizeof(point_buf), &err);
+                    if (fwrite(&point_buf[0], 1, OBP_SEEK_INDEX_POINT_SIZE, out) != OBP_SEEK_INDEX_POINT_SIZE) {
+                        printf("Failed to write seek index point.\n");
+                        ret = 1;
+                        goto end;
+                    }
+                    num_points++;
+                }
+            }
+
+            packet_pos += obu_size + (size_t) offset;
+        }
+    }
+
+    obp_seek_index_write_header(num_points, &buf[0], sizeof(buf), &err);
+    if (fseek(out, 0, SEEK_SET) != 0 || fwrite(&buf[0], 1, OBP_SEEK_INDEX_HEADER_SIZE, out) != OBP_SEEK_INDEX_HEADER_SIZE) {
+        printf("Failed to write seek index header.\n");
+        ret = 1;
+        goto end;
+    }
+
+    printf("{\"points\": %"PRIu64"}\n", num_points);
+
+end:
+    if (out != NULL && fclose(out) != 0 && ret == 0) {
+        printf("Failed to write '%s'.\n", out_path);
+        ret = 1;
+    }
+    ivf_close(&ivf);
+    mp4_close(&mp4);
+
+    return ret;
+}
+
+static int read_index(const char *path, int list, int64_t pts)
+{
+    FileMap map  = { 0 };
+    char err_buf[1024];
+    OBPError err = { &err_buf[0], 1024, OBP_ERROR_NONE, 0, NULL };
+    OBPSeekPoint point;
+    uint64_t index;
+    int ret      = 0;
+
+    if (map_open(&map, path, &err) < 0) {
+        printf("Failed to open seek index: %s\n", err.error);
+        return 1;
+    }
+
+    if (list) {
+        uint64_t num_points = 0;
+        for (index = 0; ; index++) {
+            if (obp_seek_index_get_point(map.buf, (size_t) map.size, index, &num_points, &point, &err) < 0) {
+                if (err.code != OBP_ERROR_NOT_FOUND) {
+                    printf("Failed to read seek index: %s\n", err.error);
+                    ret = 1;
+                }
+                break;
+            }
+            print_point(index, &point);
+        }
+    } else if (obp_seek_index_lookup(map.buf, (size_t) map.size, pts, &index, &point, &err) < 0) {
+        printf("Failed to look up %"PRId64": %s\n", pts, err.error);
+        ret = 1;
+    } else {
+        print_point(index, &point);
+    }
+
+    map_close(&map);
+
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && !strcmp(argv[1], "--list"))
+        return read_index(argv[2], 1, 0);
+
+    if (argc == 4 && !strcmp(argv[1], "--lookup"))
+        return read_index(argv[3], 0, strtoll(argv[2], NULL, 10));
+
+    if (argc == 3 && argv[1][0] != '-')
+        return build_index(argv[1], argv[2]);
+
+    printf("Usage: %s file.ivf|file.mp4 out.obpi\n"
+           "       %s --lookup pts in.obpi\n"
+           "       %s --list in.obpi\n", argv[0], argv[0], argv[0]);
+
+    return 1;
+}
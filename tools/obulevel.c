@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Checks that one operating point of an IVF or MP4 file stays within the Annex A
+ * limits of its signalled level and tier, using obp_level_verifier_push_frame.
+ * Frames which fail any check are printed as one JSON object per line, followed
+ * by a summary. The verifier only starts over when a new sequence header changes
+ * something it checks against, and the summary covers the whole file.
+ * Exits with 2 if any check failed.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "obuparse.h"
+#include "tools/ivf.h"
+#include "tools/mp4.h"
+
+static const char *const check_names[] = {
+    "pic_size",
+    "h_size",
+    "v_size",
+    "tiles",
+    "tile_cols",
+    "display_rate",
+    "decode_rate",
+    "header_rate",
+    "compression_ratio",
+    "buffer_underflow"
+};
+
+static void print_checks(uint32_t checks)
+{
+    int first = 1;
+
+    printf("[");
+    for (size_t i = 0; i < sizeof(check_names) / sizeof(check_names[0]); i++) {
+        if ((checks >> i) & 1) {
+            printf("%s\"%s\"", first ? "" : ", ", check_names[i]);
+            first = 0;
+        }
+    }
+    printf("]");
+}
+
+/*
+ * Peaks and minimums over the whole file, kept across verifier restarts.
+ */
+typedef struct LevelTotals {
+    uint64_t peak_display_rate;
+    uint64_t peak_decode_rate;
+    uint32_t peak_header_rate;
+    double min_compress_ratio;
+    double min_buffer_slack;
+    int have_buffer_slack;
+} LevelTotals;
+
+static void add_totals(LevelTotals *totals, OBPLevelVerifier *verifier)
+{
+    if (verifier->peak_display_rate > totals->peak_display_rate)
+        totals->peak_display_rate = verifier->peak_display_rate;
+    if (verifier->peak_decode_rate > totals->peak_decode_rate)
+        totals->peak_decode_rate = verifier->peak_decode_rate;
+    if (verifier->peak_header_rate > totals->peak_header_rate)
+        totals->peak_header_rate = verifier->peak_header_rate;
+    if (verifier->min_compress_ratio != 0.0 &&
+        (totals->min_compress_ratio == 0.0 || verifier->min_compress_ratio < totals->min_compress_ratio))
+        totals->min_compress_ratio = verifier->min_compress_ratio;
+    if (verifier->num_frames > 0 && verifier->limits.MaxBitrate != 0 &&
+        (!totals->have_buffer_slack || verifier->min_buffer_slack < totals->min_buffer_slack)) {
+        totals->min_buffer_slack  = verifier->min_buffer_slack;
+        totals->have_buffer_slack = 1;
+    }
+}
+
+/*
+ * Whether a new sequence header changes anything obp_level_verifier_init reads for
+ * the operating point, and so needs the verifier to be set up again.
+ */
+static int level_params_changed(OBPSequenceHeader *old, OBPSequenceHeader *new, int op)
+{
+    if (op > old->operating_points_cnt_minus_1 || op > new->operating_points_cnt_minus_1)
+        return 1;
+
+    return old->seq_profile != new->seq_profile ||
+           old->still_picture != new->still_picture ||
+           old->seq_level_idx[op] != new->seq_level_idx[op] ||
+           old->seq_tier[op] != new->seq_tier[op] ||
+           old->operating_point_idc[op] != new->operating_point_idc[op] ||
+           old->timing_info.time_scale != new->timing_info.time_scale ||
+           old->decoder_model_info_present_flag != new->decoder_model_info_present_flag ||
+           old->decoder_model_info.num_units_in_decoding_tick != new->decoder_model_info.num_units_in_decoding_tick ||
+           old->decoder_model_info.buffer_removal_time_length_minus_1 !=
+               new->decoder_model_info.buffer_removal_time_length_minus_1 ||
+           old->decoder_model_present_for_this_op[op] != new->decoder_model_present_for_this_op[op] ||
+           old->operating_parameters_info[op].decoder_buffer_delay != new->operating_parameters_info[op].decoder_buffer_delay ||
+           old->operating_parameters_info[op].encoder_buffer_delay != new->operating_parameters_info[op].encoder_buffer_delay ||
+           old->operating_parameters_info[op].low_delay_mode_flag != new->operating_parameters_info[op].low_delay_mode_flag;
+}
+
+static int is_ivf(const char *path)
+{
+    char sig[4] = { 0 };
+    FILE *f     = fopen(path, "rb");
+
+    if (f == NULL)
+        return 0;
+
+    if (fread(&sig[0], 1, 4, f) != 4)
+        sig[0] = 0;
+    fclose(f);
+
+    return !memcmp(&sig[0], "DKIF", 4);
+}
+
+int main(int argc, char *argv[])
+{
+    IVFReader ivf          = { 0 };
+    MP4Reader mp4          = { 0 };
+    int use_mp4            = 0;
+    char err_buf[1024];
+    OBPError err           = { &err_buf[0], 1024, OBP_ERROR_NONE, 0, NULL };
+    OBPSequenceHeader hdr  = { 0 };
+    OBPFrameHeader frame_hdr = { 0 };
+    OBPState state         = { 0 };
+    int seen_seq           = 0;
+    int operating_point    = 0;
+    int SeenFrameHeader    = 0;
+    size_t coded_size      = 0;
+    uint64_t frame_number  = 0;
+    uint32_t failed        = 0;
+    LevelTotals totals     = { 0 };
+    uint32_t timebase_num, timebase_den;
+    int ret                = 0;
+    static OBPLevelVerifier verifier;
+    static uint32_t tile_sizes[4096];
+    static uint32_t tile_offsets[4096];
+
+    if (argc < 2) {
+        printf("Usage: %s (--operating-point N) file.ivf|file.mp4\n", argv[0]);
+        return 1;
+    }
+
+    if (argc >= 4 && (!strcmp(argv[1], "-o") || !strcmp(argv[1], "--operating-point")))
+        operating_point = atoi(argv[2]);
+
+    use_mp4 = !is_ivf(argv[argc - 1]);
+
+    if (use_mp4) {
+        if (mp4_open(&mp4, argv[argc - 1], &err) < 0) {
+            printf("Failed to open MP4 file: %s\n", err.error);
+            return 1;
+        }
+        timebase_num = 1;
+        timebase_den = mp4.timescale;
+        if (mp4.seq_header_present) {
+            memcpy(&hdr, &mp4.seq_header, sizeof(hdr));
+            seen_seq = 1;
+            if (obp_level_verifier_init(&verifier, &hdr, operating_point, timebase_num, timebase_den, &err) < 0) {
+                printf("Failed to set up level verifier: %s\n", err.error);
+                ret = 1;
+                goto end;
+            }
+        }
+    } else {
+        if (ivf_open(&ivf, argv[argc - 1], &err) < 0) {
+            printf("Failed to open IVF file: %s\n", err.error);
+            return 1;
+        }
+        timebase_num = ivf.header.timebase_num;
+        timebase_den = ivf.header.timebase_den;
+    }
+
+    while (1)
+    {
+        uint8_t *packet_buf;
+        size_t packet_size;
+        size_t packet_pos = 0;
+        int64_t pts;
+        uint64_t file_offset;
+
+        if (use_mp4) {
+            int sync;
+            ret = mp4_read_sample(&mp4, &packet_buf, &packet_size, &pts, &sync, &file_offset, &err);
+        } else {
+            ret = ivf_read_frame(&ivf, &packet_buf, &packet_size, &pts, &file_offset, &err);
+        }
+        if (ret == 1) {
+            ret = 0;
+            break;
+        } else if (ret < 0) {
+            printf("Failed to read in %s: %s\n", use_mp4 ? "MP4 sample" : "IVF frame", err.error);
+            ret = 1;
+            goto end;
+        }
+
+        while (packet_pos < packet_size)
+        {
+            ptrdiff_t offset;
+            size_t obu_size;
+            int temporal_id, spatial_id;
+            int frame_done = 0;
+            OBPOBUType obu_type;
+            uint8_t *obu;
+
+            ret = obp_get_next_obu(packet_buf + packet_pos, packet_size - packet_pos,
+                                   &obu_type, &offset, &obu_size, &temporal_id, &spatial_id, &err);
+            if (ret < 0) {
+                printf("Failed to parse OBU header: %s\n", err.error);
+                ret = 1;
+                goto end;
+            }
+            obu         = packet_buf + packet_pos + offset;
+            coded_size += obu_size + (size_t) offset;
+
+            switch (obu_type) {
+            case OBP_OBU_TEMPORAL_DELIMITER: {
+                SeenFrameHeader = 0;
+                break;
+            }
+            case OBP_OBU_SEQUENCE_HEADER: {
+                OBPSequenceHeader new_hdr;
+                memset(&new_hdr, 0, sizeof(new_hdr));
+                ret = obp_parse_sequence_header(obu, obu_size, &new_hdr, &err);
+                if (ret < 0) {
+                    printf("Failed to parse sequence header: %s\n", err.error);
+                    ret = 1;
+                    goto end;
+                }
+                if (!seen_seq || level_params_changed(&hdr, &new_hdr, operating_point)) {
+                    add_totals(&totals, &verifier);
+                    ret = obp_level_verifier_init(&verifier, &new_hdr, operating_point, timebase_num, timebase_den, &err);
+                    if (ret < 0) {
+                        printf("Failed to set up level verifier: %s\n", err.error);
+                        ret = 1;
+                        goto end;
+                    }
+                }
+                memcpy(&hdr, &new_hdr, sizeof(hdr));
+                seen_seq = 1;
+                break;
+            }
+            case OBP_OBU_FRAME: {
+                OBPTileGroup tiles = { 0 };
+                tiles.TileSize     = &tile_sizes[0];
+                tiles.TileOffset   = &tile_offsets[0];
+                tiles.TileCapacity = 4096;
+                memset(&frame_hdr, 0, sizeof(frame_hdr));
+                if (!seen_seq) {
+                    printf("Encountered Frame OBU before Sequence Header OBU.\n");
+                    ret = 1;
+                    goto end;
+                }
+                ret = obp_parse_frame(obu, obu_size, &hdr, &state, temporal_id, spatial_id, &frame_hdr, &tiles,
+                                      &SeenFrameHeader, &err);
+                if (ret < 0) {
+                    printf("Failed to parse frame: %s\n", err.error);
+                    ret = 1;
+                    goto end;
+                }
+                frame_done = !SeenFrameHeader;
+                break;
+            }
+            case OBP_OBU_REDUNDANT_FRAME_HEADER:
+            case OBP_OBU_FRAME_HEADER: {
+                if (SeenFrameHeader)
+                    break;
+                memset(&frame_hdr, 0, sizeof(frame_hdr));
+                if (!seen_seq) {
+                    printf("Encountered Frame Header OBU before Sequence Header OBU.\n");
+                    ret = 1;
+                    goto end;
+                }
+                ret = obp_parse_frame_header(obu, obu_size, &hdr, &state, temporal_id, spatial_id, &frame_hdr,
+                                             &SeenFrameHeader, &err);
+                if (ret < 0) {
+                    printf("Failed to parse frame header: %s\n", err.error);
+                    ret = 1;
+                    goto end;
+                }
+                frame_done = frame_hdr.show_existing_frame;
+                break;
+            }
+            case OBP_OBU_TILE_GROUP: {
+                OBPTileGroup tiles = { 0 };
+                tiles.TileSize     = &tile_sizes[0];
+                tiles.TileOffset   = &tile_offsets[0];
+                tiles.TileCapacity = 4096;
+                ret = obp_parse_tile_group(obu, obu_size, &frame_hdr, &tiles, &SeenFrameHeader, &err);
+                if (ret < 0) {
+                    printf("Failed to parse tile group: %s\n", err.error);
+                    ret = 1;
+                    goto end;
+                }
+                frame_done = !SeenFrameHeader;
+                break;
+            }
+            default:
+                break;
+            }
+
+            if (frame_done) {
+                uint32_t violations;
+                ret = obp_level_verifier_push_frame(&verifier, &frame_hdr, temporal_id, spatial_id, pts,
+                                                    coded_size, &violations, &err);
+                if (ret < 0) {
+                    printf("Failed to verify frame: %s\n", err.error);
+                    ret = 1;
+                    goto end;
+                }
+                failed |= violations;
+                if (violations) {
+                    printf("{\"frame_number\": %"PRIu64", \"pts\": %"PRId64", \"coded_size\": %zu, \"failed\": ",
+                           frame_number, pts, coded_size);
+                    print_checks(violations);
+                    printf("}\n");
+                }
+                coded_size = 0;
+                frame_number++;
+            }
+
+            packet_pos += obu_size + (size_t) offset;
+        }
+    }
+
+    add_totals(&totals, &verifier);
+
+    printf("{\"operating_point\": %d, \"seq_level_idx\": %d, \"seq_tier\": %d, \"frames\": %"PRIu64", "
+           "\"peak_display_rate\": %"PRIu64", \"peak_decode_rate\": %"PRIu64", \"peak_header_rate\": %"PRIu32", "
+           "\"min_compress_ratio\": %.3f, \"min_buffer_slack\": %.6f, \"failed\": ",
+           operating_point, seen_seq ? hdr.seq_level_idx[operating_point] : -1,
+           seen_seq ? hdr.seq_tier[operating_point] : -1, frame_number, totals.peak_display_rate,
+           totals.peak_decode_rate, totals.peak_header_rate, totals.min_compress_ratio, totals.min_buffer_slack);
+    print_checks(failed);
+    printf("}\n");
+
+    if (failed)
+        ret = 2;
+
+end:
+    ivf_close(&ivf);
+    mp4_close(&mp4);
+
+    return ret;
+}
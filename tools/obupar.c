@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 2020, Derek Buitenhuis
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Multi-threaded frame header parser for long IVF files.
+ *
+ * The file is split into segments, each starting at a temporal unit which
+ * carries a Sequence Header OBU and a shown key frame. A shown key frame
+ * refreshes every reference slot, so no state carries over from before it,
+ * and each segment can be parsed on its own thread with its own OBPState.
+ * Per-frame results are printed in stream order, one JSON object per line.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "obuparse.h"
+#include "tools/ivf.h"
+
+typedef struct Packet {
+    uint8_t *buf;
+    size_t size;
+} Packet;
+
+typedef struct FrameResult {
+    int packet_number;
+    OBPOBUType obu_type;
+    int show_existing_frame;
+    OBPFrameType frame_type;
+    int show_frame;
+    uint8_t order_hint;
+    uint8_t refresh_frame_flags;
+    uint8_t base_q_idx;
+    uint16_t NumTiles;
+} FrameResult;
+
+typedef struct Segment {
+    int first_packet;
+    int num_packets;
+    int num_frames;
+    FrameResult *frames;
+    int frames_done;
+    int done;
+    int failed;
+    char error[1024];
+} Segment;
+
+typedef struct Context {
+    Packet *packets;
+    Segment *segments;
+    int num_segments;
+    int next_segment;
+    int abort;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Context;
+
+static int is_frame_obu(OBPOBUType obu_type)
+{
+    return obu_type == OBP_OBU_FRAME || obu_type == OBP_OBU_FRAME_HEADER ||
+           obu_type == OBP_OBU_REDUNDANT_FRAME_HEADER;
+}
+
+static int read_packets(IVFReader *ivf, Packet **packets, int *num_packets)
+{
+    int capacity = 0;
+
+    *num_packets = 0;
+    while (1) {
+        char err_buf[1024];
+        OBPError err = { &err_buf[0], 1024, OBP_ERROR_NONE, 0, NULL };
+        uint8_t *packet_buf;
+        size_t packet_size;
+        int64_t pts;
+        uint64_t file_offset;
+        int ret;
+
+        ret = ivf_read_frame(ivf, &packet_buf, &packet_size, &pts, &file_offset, &err);
+        if (ret == 1)
+            break;
+        if (ret < 0) {
+            printf("Failed to read in IVF frame %d: %s\n", *num_packets, err.error);
+            return -1;
+        }
+
+        if (*num_packets == capacity) {
+            Packet *tmp;
+            capacity = capacity ? capacity * 2 : 1024;
+            tmp      = realloc(*packets, capacity * sizeof(**packets));
+            if (tmp == NULL) {
+                printf("Could not allocate packet list.\n");
+                return -1;
+            }
+            *packets = tmp;
+        }
+
+        (*packets)[*num_packets].buf  = packet_buf;
+        (*packets)[*num_packets].size = packet_size;
+        (*num_packets)++;
+    }
+
+    return 0;
+}
+
+/*
+ * Returns 1 if the packet starts a new segment, i.e. it has a Sequence Header
+ * OBU and its first frame header is a shown key frame, and counts the frame
+ * header OBUs in it.
+ */
+static int scan_packet(Packet *pkt, OBPSequenceHeader *hdr, int *seen_seq, int *num_frames, char *error)
+{
+    size_t packet_pos = 0;
+    int has_seq       = 0;
+    int first_frame   = 1;
+    int key           = 0;
+
+    while (packet_pos < pkt->size) {
+        ptrdiff_t offset;
+        size_t obu_size;
+        int temporal_id, spatial_id;
+        OBPOBUType obu_type;
+        OBPError err = { error, 1024, OBP_ERROR_NONE, 0, NULL };
+
+        if (obp_get_next_obu(pkt->buf + packet_pos, pkt->size - packet_pos, &obu_type, &offset,
+                             &obu_size, &temporal_id, &spatial_id, &err) < 0)
+            return -1;
+
+        if (obu_type == OBP_OBU_SEQUENCE_HEADER) {
+            memset(hdr, 0, sizeof(*hdr));
+            if (obp_parse_sequence_header(pkt->buf + packet_pos + offset, obu_size, hdr, &err) < 0)
+                return -1;
+            has_seq   = 1;
+            *seen_seq = 1;
+        } else if (is_frame_obu(obu_type)) {
+            if (first_frame && obu_type != OBP_OBU_REDUNDANT_FRAME_HEADER && *seen_seq) {
+                /*
+                 * show_existing_frame, frame_type, and show_frame are the first bits of
+                 * uncompressed_header() unless reduced_still_picture_header is set, in
+                 * which case every frame is a shown key frame.
+                 */
+                if (hdr->reduced_still_picture_header)
+                    key = 1;
+                else if (obu_size > 0)
+                    key = ((pkt->buf[packet_pos + offset] >> 4) == 0x1);
+                first_frame = 0;
+            }
+            (*num_frames)++;
+        }
+
+        packet_pos += obu_size + (size_t) offset;
+    }
+
+    return has_seq && key;
+}
+
+static int parse_segment(Context *ctx, Segment *seg, uint32_t *tile_sizes, uint32_t *tile_offsets)
+{
+    OBPSequenceHeader hdr    = { 0 };
+    OBPFrameHeader frame_hdr = { 0 };
+    OBPState *state;
+    int seen_seq             = 0;
+    int SeenFrameHeader      = 0;
+
+    /* OBPState is too large to comfortably put on a thread's stack. */
+    state = calloc(1, sizeof(*state));
+    if (state == NULL) {
+        snprintf(seg->error, sizeof(seg->error), "Could not allocate state.");
+        return -1;
+    }
+
+    for (int i = seg->first_packet; i < seg->first_packet + seg->num_packets; i++) {
+        Packet *pkt       = &ctx->packets[i];
+        size_t packet_pos = 0;
+
+        while (packet_pos < pkt->size) {
+            ptrdiff_t offset;
+            size_t obu_size;
+            int temporal_id, spatial_id;
+            OBPOBUType obu_type;
+            OBPError err  = { &seg->error[0], 1024, OBP_ERROR_NONE, 0, NULL };
+            uint8_t *obu;
+            int ret = 0;
+
+            if (obp_get_next_obu(pkt->buf + packet_pos, pkt->size - packet_pos, &obu_type, &offset,
+                                 &obu_size, &temporal_id, &spatial_id, &err) < 0)
+                goto fail;
+
+            obu = pkt->buf + packet_pos + offset;
+
+            switch (obu_type) {
+            case OBP_OBU_TEMPORAL_DELIMITER:
+                SeenFrameHeader = 0;
+                break;
+            case OBP_OBU_SEQUENCE_HEADER:
+                seen_seq = 1;
+                memset(&hdr, 0, sizeof(hdr));
+                ret = obp_parse_sequence_header(obu, obu_size, &hdr, &err);
+                break;
+            case OBP_OBU_FRAME:
+            case OBP_OBU_FRAME_HEADER:
+            case OBP_OBU_REDUNDANT_FRAME_HEADER: {
+                FrameResult *res   = &seg->frames[seg->frames_done];
+                OBPTileGroup tiles = { 0 };
+                tiles.TileSize     = tile_sizes;
+                tiles.TileOffset   = tile_offsets;
+                tiles.TileCapacity = 4096;
+                if (!seen_seq) {
+                    snprintf(seg->error, sizeof(seg->error), "Encountered Frame Header OBU before Sequence Header OBU.");
+                    goto fail;
+                }
+                memset(&frame_hdr, 0, sizeof(frame_hdr));
+                if (obu_type == OBP_OBU_FRAME)
+                    ret = obp_parse_frame(obu, obu_size, &hdr, state, temporal_id, spatial_id, &frame_hdr, &tiles,
+                                          &SeenFrameHeader, &err);
+                else
+                    ret = obp_parse_frame_header(obu, obu_size, &hdr, state, temporal_id, spatial_id, &frame_hdr,
+                                                 &SeenFrameHeader, &err);
+                if (ret < 0)
+                    break;
+                res->packet_number       = i;
+                res->obu_type            = obu_type;
+                res->show_existing_frame = frame_hdr.show_existing_frame;
+                res->frame_type          = frame_hdr.frame_type;
+                res->show_frame          = frame_hdr.show_frame;
+                res->order_hint          = frame_hdr.order_hint;
+                res->refresh_frame_flags = frame_hdr.refresh_frame_flags;
+                res->base_q_idx          = frame_hdr.quantization_params.base_q_idx;
+                res->NumTiles            = tiles.NumTiles;
+                seg->frames_done++;
+                break;
+            }
+            case OBP_OBU_TILE_GROUP: {
+                OBPTileGroup tiles = { 0 };
+                tiles.TileSize     = tile_sizes;
+                tiles.TileOffset   = tile_offsets;
+                tiles.TileCapacity = 4096;
+                ret = obp_parse_tile_group(obu, obu_size, &frame_hdr, &tiles, &SeenFrameHeader, &err);
+                break;
+            }
+            default:
+                break;
+            }
+
+            if (ret < 0)
+                goto fail;
+
+            packet_pos += obu_size + (size_t) offset;
+        }
+    }
+
+    free(state);
+    return 0;
+
+fail:
+    free(state);
+    return -1;
+}
+
+static void *worker(void *arg)
+{
+    Context *ctx           = arg;
+    uint32_t *tile_sizes   = malloc(4096 * sizeof(*tile_sizes));
+    uint32_t *tile_offsets = malloc(4096 * sizeof(*tile_offsets));
+
+    while (1) {
+        Segment *seg;
+        int failed;
+
+        pthread_mutex_lock(&ctx->lock);
+        if (ctx->abort || ctx->next_segment == ctx->num_segments) {
+            pthread_mutex_unlock(&ctx->lock);
+            break;
+        }
+        seg = &ctx->segments[ctx->next_segment++];
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (tile_sizes == NULL || tile_offsets == NULL) {
+            snprintf(seg->error, sizeof(seg->error), "Could not allocate tile buffers.");
+            failed = 1;
+        } else {
+            failed = parse_segment(ctx, seg, tile_sizes, tile_offsets) < 0;
+        }
+
+        pthread_mutex_lock(&ctx->lock);
+        seg->failed = failed;
+        seg->done   = 1;
+        pthread_cond_broadcast(&ctx->cond);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+
+    free(tile_sizes);
+    free(tile_offsets);
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    IVFReader ivf          = { 0 };
+    char err_buf[1024];
+    OBPError err           = { &err_buf[0], 1024, OBP_ERROR_NONE, 0, NULL };
+    Packet *packets        = NULL;
+    pthread_t *threads     = NULL;
+    Context ctx            = { 0 };
+    OBPSequenceHeader hdr  = { 0 };
+    int num_packets        = 0;
+    int num_threads        = 0;
+    int num_started        = 0;
+    int seen_seq           = 0;
+    int ret                = 0;
+
+    if (argc < 2) {
+        printf("Usage: %s (--threads N) file.ivf\n", argv[0]);
+        return 1;
+    }
+
+    if (argc > 3 && (!strcmp(argv[1], "-t") || !strcmp(argv[1], "--threads")))
+        num_threads = atoi(argv[2]);
+
+    if (num_threads <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+        num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        if (num_threads <= 0)
+            num_threads = 1;
+    }
+
+    if (ivf_open(&ivf, argv[argc - 1], &err) < 0) {
+        printf("Failed to open IVF file: %s\n", err.error);
+        ret = 1;
+        goto end;
+    }
+
+    if (read_packets(&ivf, &packets, &num_packets) < 0) {
+        ret = 1;
+        goto end;
+    }
+
+    ctx.packets  = packets;
+    ctx.segments = calloc(num_packets > 0 ? num_packets : 1, sizeof(*ctx.segments));
+    if (ctx.segments == NULL) {
+        printf("Could not allocate segment list.\n");
+        ret = 1;
+        goto end;
+    }
+
+    /* The first segment always starts at the first packet, key frame or not. */
+    for (int i = 0; i < num_packets; i++) {
+        char error[1024];
+        int num_frames = 0;
+        int start      = scan_packet(&packets[i], &hdr, &seen_seq, &num_frames, &error[0]);
+        Segment *seg;
+
+        if (start < 0) {
+            printf("Failed to scan packet %d: %s\n", i, error);
+            ret = 1;
+            goto end;
+        }
+
+        if (start || ctx.num_segments == 0) {
+            seg               = &ctx.segments[ctx.num_segments++];
+            seg->first_packet = i;
+        }
+
+        seg              = &ctx.segments[ctx.num_segments - 1];
+        seg->num_packets++;
+        seg->num_frames += num_frames;
+    }
+
+    for (int i = 0; i < ctx.num_segments; i++) {
+        Segment *seg = &ctx.segments[i];
+        seg->frames  = malloc((seg->num_frames > 0 ? seg->num_frames : 1) * sizeof(*seg->frames));
+        if (seg->frames == NULL) {
+            printf("Could not allocate frame results.\n");
+            ret = 1;
+            goto end;
+        }
+    }
+
+    if (num_threads > ctx.num_segments)
+        num_threads = ctx.num_segments;
+
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.cond, NULL);
+
+    threads = calloc(num_threads > 0 ? num_threads : 1, sizeof(*threads));
+    if (threads == NULL) {
+        printf("Could not allocate threads.\n");
+        ret = 1;
+        goto join;
+    }
+
+    for (num_started = 0; num_started < num_threads; num_started++) {
+        if (pthread_create(&threads[num_started], NULL, worker, &ctx) != 0) {
+            if (num_started == 0) {
+                printf("Could not create any threads.\n");
+                ret = 1;
+                goto join;
+            }
+            break;
+        }
+    }
+
+    fprintf(stderr, "Parsing %d packets in %d segments on %d threads.\n", num_packets, ctx.num_segments, num_started);
+
+    /* Print each segment as soon as it, and every segment before it, is done. */
+    for (int i = 0; i < ctx.num_segments; i++) {
+        Segment *seg = &ctx.segments[i];
+
+        pthread_mutex_lock(&ctx.lock);
+        while (!seg->done)
+            pthread_cond_wait(&ctx.cond, &ctx.lock);
+        pthread_mutex_unlock(&ctx.lock);
+
+        for (int j = 0; j < seg->frames_done; j++) {
+            FrameResult *res = &seg->frames[j];
+            printf("{\"packet_number\": %d, \"obu_type\": %d, \"show_existing_frame\": %d, \"frame_type\": %d, "
+                   "\"show_frame\": %d, \"order_hint\": %"PRIu8", \"refresh_frame_flags\": %"PRIu8", "
+                   "\"base_q_idx\": %"PRIu8", \"NumTiles\": %"PRIu16"}\n",
+                   res->packet_number, res->obu_type, res->show_existing_frame, res->frame_type, res->show_frame,
+                   res->order_hint, res->refresh_frame_flags, res->base_q_idx, res->NumTiles);
+        }
+
+        if (seg->failed) {
+            printf("Failed to parse segment starting at packet %d: %s\n", seg->first_packet, seg->error);
+            pthread_mutex_lock(&ctx.lock);
+            ctx.abort = 1;
+            pthread_mutex_unlock(&ctx.lock);
+            ret = 1;
+            break;
+        }
+    }
+
+join:
+    for (int i = 0; i < num_started; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_cond_destroy(&ctx.cond);
+    pthread_mutex_destroy(&ctx.lock);
+
+end:
+    if (ctx.segments != NULL) {
+        for (int i = 0; i < ctx.num_segments; i++)
+            free(ctx.segments[i].frames);
+    }
+    free(ctx.segments);
+    free(threads);
+    free(packets);
+    ivf_close(&ivf);
+
+    return ret;
+}